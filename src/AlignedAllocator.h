@@ -0,0 +1,90 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*
+ * Minimal allocator that aligns the storage of standard containers to
+ * `ALIGN` bytes. Used to keep the arrays read by the decoder hot loop
+ * aligned to cache lines (which also satisfies the SIMD load alignment).
+ */
+template <typename T, std::size_t ALIGN = 64>
+struct AlignedAllocator {
+   typedef T value_type;
+
+   template <typename U>
+   struct rebind {
+      typedef AlignedAllocator<U, ALIGN> other;
+   };
+
+   AlignedAllocator() noexcept = default;
+
+   template <typename U>
+   AlignedAllocator(const AlignedAllocator<U, ALIGN> &) noexcept {
+      // Empty by design.
+   }
+
+   T *allocate(std::size_t n) {
+      return static_cast<T*>(::operator new(n*sizeof(T), std::align_val_t(ALIGN)));
+   }
+
+   void deallocate(T *ptr, std::size_t) noexcept {
+      ::operator delete(ptr, std::align_val_t(ALIGN));
+   }
+
+   template <typename U>
+   bool operator==(const AlignedAllocator<U, ALIGN> &) const noexcept {
+      return true;
+   }
+
+   template <typename U>
+   bool operator!=(const AlignedAllocator<U, ALIGN> &) const noexcept {
+      return false;
+   }
+};
+
+/// Vector whose storage is aligned to cache lines.
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+/// Number of elements of type T that fill a cache line.
+template <typename T>
+constexpr int cacheLineElems() {
+   return 64 / sizeof(T);
+}
+
+/// Rounds `n` up to a multiple of the number of T elements in a cache line.
+template <typename T>
+constexpr int padToCacheLine(int n) {
+   return (n + cacheLineElems<T>() - 1) / cacheLineElems<T>() * cacheLineElems<T>();
+}
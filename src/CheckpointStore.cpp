@@ -0,0 +1,121 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "CheckpointStore.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void CheckpointStore::setup(int slots, int numTasks, int numVehicles) {
+   m_slots.clear();
+   m_current = nullptr;
+
+   // About 32 checkpoints per decoding.
+   m_stride = max(1, (numTasks + 31)/32);
+   const int count = numTasks/m_stride + 1;
+
+   m_slots.resize(max(slots, 0));
+   for (auto &slot: m_slots) {
+      slot.order.resize(numTasks);
+      slot.ties.resize(numTasks);
+      slot.checkpoints.resize(count);
+      for (auto &cp: slot.checkpoints) {
+         cp.vehiPos.resize(numVehicles);
+         cp.vehiLeaveTime.resize(numVehicles);
+         cp.wtime.resize(numVehicles);
+      }
+   }
+}
+
+int CheckpointStore::resume(const std::vector<int> &order, const std::vector<double> &chromosome,
+      DecodeState &state, std::vector<double> &wtime) {
+   const int n = order.size();
+   const int flags = (chromosome[n] >= 0.5) | (chromosome[n+1] >= 0.5) << 1;
+
+   // Finds the slot sharing the longest prefix with the decoding.
+   Slot *best = nullptr;
+   int bestPrefix = 0;
+   for (auto &slot: m_slots) {
+      if (slot.flags != flags || slot.valid == 0)
+         continue;
+      int prefix = 0;
+      while (prefix < slot.valid && slot.order[prefix] == order[prefix] &&
+            slot.ties[prefix] == (chromosome[prefix] >= 0.5))
+         ++prefix;
+      if (prefix > bestPrefix) {
+         bestPrefix = prefix;
+         best = &slot;
+      }
+   }
+
+   int start = 0;
+   if (best && bestPrefix >= m_stride) {
+      // Restores the checkpoint, and keeps those of the shared prefix.
+      start = bestPrefix - bestPrefix % m_stride;
+      const Checkpoint &cp = best->checkpoints[start / m_stride];
+      copy(cp.vehiPos.begin(), cp.vehiPos.end(), state.vehiPos.begin());
+      copy(cp.vehiLeaveTime.begin(), cp.vehiLeaveTime.end(), state.vehiLeaveTime.begin());
+      copy(cp.wtime.begin(), cp.wtime.end(), wtime.begin());
+      state.dist = cp.dist;
+      state.tard = cp.tard;
+      state.tmax = cp.tmax;
+      state.cachedCost = cp.cachedCost;
+      m_current = best;
+      m_current->valid = bestPrefix;
+   } else {
+      m_current = &*min_element(m_slots.begin(), m_slots.end(), [](const Slot &a, const Slot &b) {
+         return a.lastUse < b.lastUse;
+      });
+      m_current->valid = 0;
+   }
+
+   // Records the decoding over the slot.
+   m_current->flags = flags;
+   m_current->lastUse = ++m_clock;
+   for (int i = m_current->valid; i < n; ++i) {
+      m_current->order[i] = order[i];
+      m_current->ties[i] = chromosome[i] >= 0.5;
+   }
+
+   tasksDecoded += n - start;
+   tasksSkipped += start;
+   return start;
+}
+
+void CheckpointStore::store(int step, const DecodeState &state, const std::vector<double> &wtime) {
+   Checkpoint &cp = m_current->checkpoints[step / m_stride];
+   copy(state.vehiPos.begin(), state.vehiPos.end(), cp.vehiPos.begin());
+   copy(state.vehiLeaveTime.begin(), state.vehiLeaveTime.end(), cp.vehiLeaveTime.begin());
+   copy(wtime.begin(), wtime.end(), cp.wtime.begin());
+   cp.dist = state.dist;
+   cp.tard = state.tard;
+   cp.tmax = state.tmax;
+   cp.cachedCost = state.cachedCost;
+}
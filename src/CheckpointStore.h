@@ -0,0 +1,110 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include "Solution.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Partial states of recent decodings, saved every `stride` tasks, so that a
+ * chromosome sharing a prefix of the decoding with one of them resumes from
+ * the last checkpoint within that prefix instead of the first task.
+ *
+ * The state before the i-th task depends only on the flags, the first i
+ * tasks of the order and the tie-breaking keys of the first i positions.
+ * Each slot records those for one decoding, along with its checkpoints.
+ * A decoding that resumes from a slot is recorded over it, keeping the
+ * checkpoints of the shared prefix; otherwise, it takes the least
+ * recently used slot.
+ */
+class CheckpointStore {
+public:
+   /// Allocates `slots` slots (zero disables the store). Not thread-safe.
+   void setup(int slots, int numTasks, int numVehicles);
+
+   bool enabled() const {
+      return !m_slots.empty();
+   }
+
+   int stride() const {
+      return m_stride;
+   }
+
+   /**
+    * Selects the slot that records the decoding of `order` and restores the
+    * state and workloads of the latest usable checkpoint. Returns the number
+    * of tasks already decoded in the restored state.
+    */
+   int resume(const std::vector <int> &order, const std::vector <double> &chromosome,
+      DecodeState &state, std::vector <double> &wtime);
+
+   /// Saves the state before the `step`-th task, if it is a checkpoint.
+   void save(int step, const DecodeState &state, const std::vector <double> &wtime) {
+      if (step % m_stride == 0 && step > m_current->valid)
+         store(step, state, wtime);
+   }
+
+   /// Marks the decoding recorded by the current slot as complete.
+   void finish(int numTasks) {
+      m_current->valid = numTasks;
+   }
+
+   // Tasks decoded, and tasks skipped by resuming from checkpoints.
+   uint64_t tasksDecoded {0};
+   uint64_t tasksSkipped {0};
+
+private:
+   struct Checkpoint {
+      std::vector <int> vehiPos;
+      std::vector <double> vehiLeaveTime;
+      std::vector <double> wtime;
+      double dist, tard, tmax, cachedCost;
+   };
+
+   struct Slot {
+      int flags {-1};
+      std::vector <int> order;
+      std::vector <char> ties;
+      std::vector <Checkpoint> checkpoints;
+
+      // Checkpoints up to this step hold the states of the recorded decoding.
+      int valid {0};
+      uint64_t lastUse {0};
+   };
+
+   void store(int step, const DecodeState &state, const std::vector <double> &wtime);
+
+   int m_stride {1};
+   uint64_t m_clock {0};
+   std::vector <Slot> m_slots;
+   Slot *m_current {nullptr};
+};
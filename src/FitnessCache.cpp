@@ -0,0 +1,141 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "FitnessCache.h"
+
+using namespace std;
+
+namespace {
+
+inline uint64_t rotl(uint64_t x, int r) {
+   return (x << r) | (x >> (64 - r));
+}
+
+/// Finalization step of MurmurHash3.
+inline uint64_t fmix(uint64_t x) {
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdULL;
+   x ^= x >> 33;
+   x *= 0xc4ceb9fe1a85ec53ULL;
+   x ^= x >> 33;
+   return x;
+}
+
+}
+
+void FitnessCache::Hasher::add(uint64_t word) {
+   m_a = rotl((m_a ^ word) * 0x87c37b91114253d5ULL, 31);
+   m_b = rotl(m_b + word * 0x4cf5ad432745937fULL, 27) ^ m_a;
+   m_b = m_b * 5 + 0x52dce729;
+   ++m_len;
+}
+
+FitnessCache::Key FitnessCache::Hasher::finish() const {
+   Key key;
+   key.lo = fmix(m_a + m_len);
+   key.hi = fmix(m_b ^ key.lo);
+   return key;
+}
+
+void FitnessCache::setCapacity(size_t capacity) {
+   m_entries.clear();
+   m_entries.shrink_to_fit();
+   m_stripes.reset(new Stripe[STRIPES]);
+   m_setMask = 0;
+   if (capacity == 0)
+      return;
+
+   size_t sets = 1;
+   while (sets*WAYS < capacity)
+      sets *= 2;
+   m_entries.resize(sets*WAYS);
+   m_setMask = sets-1;
+}
+
+bool FitnessCache::find(const Key &key, double &fitness) {
+   const uint64_t set = key.lo & m_setMask;
+   Stripe &stripe = m_stripes[set % STRIPES];
+   Entry *entries = &m_entries[set*WAYS];
+
+   lock_guard<mutex> lock(stripe.mutex);
+   for (int w = 0; w < WAYS; ++w) {
+      Entry &e = entries[w];
+      if (e.stamp && e.key.lo == key.lo && e.key.hi == key.hi) {
+         e.stamp = ++stripe.clock;
+         fitness = e.fitness;
+         ++stripe.hits;
+         return true;
+      }
+   }
+   ++stripe.misses;
+   return false;
+}
+
+void FitnessCache::insert(const Key &key, double fitness) {
+   const uint64_t set = key.lo & m_setMask;
+   Stripe &stripe = m_stripes[set % STRIPES];
+   Entry *entries = &m_entries[set*WAYS];
+
+   lock_guard<mutex> lock(stripe.mutex);
+
+   // Reuses the entry of the key, if another thread inserted it meanwhile,
+   // or else the least recently used one.
+   Entry *victim = &entries[0];
+   for (int w = 0; w < WAYS; ++w) {
+      Entry &e = entries[w];
+      if (e.stamp && e.key.lo == key.lo && e.key.hi == key.hi) {
+         victim = &e;
+         break;
+      }
+      if (e.stamp < victim->stamp)
+         victim = &e;
+   }
+
+   if (victim->stamp && (victim->key.lo != key.lo || victim->key.hi != key.hi))
+      ++stripe.evictions;
+
+   victim->key = key;
+   victim->fitness = fitness;
+   victim->stamp = ++stripe.clock;
+}
+
+FitnessCache::Stats FitnessCache::stats() const {
+   Stats total;
+   total.capacity = m_entries.size();
+   if (!m_stripes)
+      return total;
+
+   for (int s = 0; s < STRIPES; ++s) {
+      lock_guard<mutex> lock(m_stripes[s].mutex);
+      total.hits += m_stripes[s].hits;
+      total.misses += m_stripes[s].misses;
+      total.evictions += m_stripes[s].evictions;
+   }
+   return total;
+}
@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Bounded cache of decoded fitness values, shared by all threads.
+ *
+ * Entries are keyed by a 128-bit hash of everything the decoding depends on,
+ * so the full representation is not stored. The table is 4-way set
+ * associative: each key maps to a set of 4 entries, and a full set evicts
+ * its least recently used entry. Sets are guarded by a fixed number of
+ * mutexes (lock striping), so threads rarely contend.
+ */
+class FitnessCache {
+public:
+   struct Key {
+      uint64_t lo {0};
+      uint64_t hi {0};
+   };
+
+   /// Incremental 128-bit hashing of a sequence of 64-bit words.
+   class Hasher {
+   public:
+      void add(uint64_t word);
+      Key finish() const;
+
+   private:
+      uint64_t m_a {0x9e3779b97f4a7c15ULL};
+      uint64_t m_b {0xc2b2ae3d27d4eb4fULL};
+      uint64_t m_len {0};
+   };
+
+   struct Stats {
+      uint64_t hits {0};
+      uint64_t misses {0};
+      uint64_t evictions {0};
+      size_t capacity {0};
+   };
+
+   FitnessCache() = default;
+
+   /// Allocates room for about `capacity` entries, discarding all entries
+   /// and counters. Zero disables the cache. Not thread-safe.
+   void setCapacity(size_t capacity);
+
+   bool enabled() const {
+      return !m_entries.empty();
+   }
+
+   /// Looks the key up, counting a hit or a miss.
+   bool find(const Key &key, double &fitness);
+
+   void insert(const Key &key, double fitness);
+
+   /// Sums the counters of all stripes.
+   Stats stats() const;
+
+private:
+   static constexpr int WAYS = 4;
+   static constexpr int STRIPES = 64;
+
+   struct Entry {
+      Key key;
+      double fitness;
+      uint64_t stamp {0}; // zero for unused entries
+   };
+
+   struct alignas(64) Stripe {
+      std::mutex mutex;
+      uint64_t clock {0};
+      uint64_t hits {0};
+      uint64_t misses {0};
+      uint64_t evictions {0};
+   };
+
+   std::vector <Entry> m_entries;
+   std::unique_ptr <Stripe[]> m_stripes;
+   uint64_t m_setMask {0};
+};
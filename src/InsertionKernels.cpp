@@ -0,0 +1,390 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "InsertionKernels.h"
+#include "Solution.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INSERTION_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(Instance::VehiclePair) == 2*sizeof(int), "Vehicle pairs must be packed to be loaded as vectors.");
+
+namespace {
+
+const double C0 = DecodeState::COEFS[0];
+const double C1 = DecodeState::COEFS[1];
+const double C2 = DecodeState::COEFS[2];
+
+// The scalar expressions below mirror those of `DecodeState::insertionCost`
+// operation by operation, so that results are bit-identical. The vector
+// versions use `max_pd(b, a)`, which returns `b > a ? b : a`, exactly as
+// `std::max(a, b)` does.
+
+template <bool ConvHull>
+inline double singleCost(const InsertionParams &p, double dist, double leave, double depot) {
+   const double arrival = max(p.twMin, leave + dist);
+   const double tardiness = max(0.0, arrival - p.twMax);
+   const double incDist = ConvHull ? - depot + dist + p.depotDist : dist;
+   return
+      C0 * (p.dist + incDist) +
+      C1 * (p.tard + tardiness) +
+      C2 * max(p.tmax, tardiness)
+   ;
+}
+
+template <bool ConvHull, bool Sim>
+inline double pairCost(const InsertionParams &p, double arrival0, double arrival1,
+      double dist0, double dist1, double depot0, double depot1) {
+   double tardiness0, tardiness1;
+   if constexpr (Sim) {
+      const double startTime = max(arrival0, arrival1);
+      tardiness0 = max(0.0, startTime - p.twMax);
+      tardiness1 = tardiness0;
+   } else {
+      double startTime0 = arrival0;
+      const double startTime1 = max(arrival1, startTime0 + p.deltaMin);
+      startTime0 += max(0.0, (startTime1 - startTime0) - p.deltaMax);
+      tardiness0 = max(0.0, startTime0 - p.twMax);
+      tardiness1 = max(0.0, startTime1 - p.twMax);
+   }
+
+   const double incDist = ConvHull ?
+      - depot0 - depot1 + dist0 + dist1 + p.depotDist + p.depotDist :
+      dist0 + dist1;
+
+   return
+      C0 * (p.dist + incDist) +
+      C1 * (p.tard + (tardiness0 + tardiness1)) +
+      C2 * max(p.tmax, max(tardiness0, tardiness1))
+   ;
+}
+
+template <bool ConvHull>
+void singleScalar(const InsertionParams &p, int n, const double *dist,
+      const double *leave, const double *depot, double *cost) {
+   for (int j = 0; j < n; ++j)
+      cost[j] = singleCost<ConvHull>(p, dist[j], leave[j], ConvHull ? depot[j] : 0.0);
+}
+
+template <bool ConvHull, bool Heur, bool Sim>
+void pairsScalar(const InsertionParams &p, int n, const Instance::VehiclePair *pairs,
+      const double *arrival, const double *dist, const double *depot,
+      const double *wtime, double *cost) {
+   for (int j = 0; j < n; ++j) {
+      const int v0 = pairs[j].v0;
+      const int v1 = pairs[j].v1;
+      cost[j] = pairCost<ConvHull, Sim>(p, arrival[v0], arrival[v1], dist[v0], dist[v1],
+         ConvHull ? depot[v0] : 0.0, ConvHull ? depot[v1] : 0.0);
+      if constexpr (Heur)
+         cost[j] += wtime[v1];
+   }
+}
+
+#ifdef INSERTION_KERNELS_X86
+
+// Some GCC versions report uninitialized values inside the definitions of the
+// intrinsics (GCC bug 105593), which are false positives.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+template <bool ConvHull>
+__attribute__((target("avx2")))
+void singleAvx2(const InsertionParams &p, int n, const double *dist,
+      const double *leave, const double *depot, double *cost) {
+   const __m256d zero = _mm256_setzero_pd();
+   const __m256d sign = _mm256_set1_pd(-0.0);
+   const __m256d twMin = _mm256_set1_pd(p.twMin);
+   const __m256d twMax = _mm256_set1_pd(p.twMax);
+   const __m256d depotDist = _mm256_set1_pd(p.depotDist);
+   const __m256d solDist = _mm256_set1_pd(p.dist);
+   const __m256d solTard = _mm256_set1_pd(p.tard);
+   const __m256d solTmax = _mm256_set1_pd(p.tmax);
+   const __m256d c0 = _mm256_set1_pd(C0), c1 = _mm256_set1_pd(C1), c2 = _mm256_set1_pd(C2);
+
+   int j = 0;
+   for (; j + 4 <= n; j += 4) {
+      const __m256d d = _mm256_loadu_pd(dist + j);
+      const __m256d arrival = _mm256_max_pd(_mm256_add_pd(_mm256_loadu_pd(leave + j), d), twMin);
+      const __m256d tardiness = _mm256_max_pd(_mm256_sub_pd(arrival, twMax), zero);
+
+      __m256d incDist = d;
+      if constexpr (ConvHull) {
+         const __m256d h = _mm256_xor_pd(_mm256_loadu_pd(depot + j), sign);
+         incDist = _mm256_add_pd(_mm256_add_pd(h, d), depotDist);
+      }
+
+      const __m256d c = _mm256_add_pd(_mm256_add_pd(
+         _mm256_mul_pd(c0, _mm256_add_pd(solDist, incDist)),
+         _mm256_mul_pd(c1, _mm256_add_pd(solTard, tardiness))),
+         _mm256_mul_pd(c2, _mm256_max_pd(tardiness, solTmax)));
+      _mm256_storeu_pd(cost + j, c);
+   }
+
+   singleScalar<ConvHull>(p, n - j, dist + j, leave + j, ConvHull ? depot + j : depot, cost + j);
+}
+
+template <bool ConvHull, bool Heur, bool Sim>
+__attribute__((target("avx2")))
+void pairsAvx2(const InsertionParams &p, int n, const Instance::VehiclePair *pairs,
+      const double *arrival, const double *dist, const double *depot,
+      const double *wtime, double *cost) {
+   const __m256d zero = _mm256_setzero_pd();
+   const __m256d sign = _mm256_set1_pd(-0.0);
+   const __m256d twMax = _mm256_set1_pd(p.twMax);
+   const __m256d deltaMin = _mm256_set1_pd(p.deltaMin);
+   const __m256d deltaMax = _mm256_set1_pd(p.deltaMax);
+   const __m256d depotDist = _mm256_set1_pd(p.depotDist);
+   const __m256d solDist = _mm256_set1_pd(p.dist);
+   const __m256d solTard = _mm256_set1_pd(p.tard);
+   const __m256d solTmax = _mm256_set1_pd(p.tmax);
+   const __m256d c0 = _mm256_set1_pd(C0), c1 = _mm256_set1_pd(C1), c2 = _mm256_set1_pd(C2);
+   const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+   int j = 0;
+   for (; j + 4 <= n; j += 4) {
+      // Splits four (v0, v1) pairs into vectors of v0 and v1 indices.
+      const __m256i vv = _mm256_permutevar8x32_epi32(
+         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs + j)), split);
+      const __m128i v0 = _mm256_castsi256_si128(vv);
+      const __m128i v1 = _mm256_extracti128_si256(vv, 1);
+
+      const __m256d arrival0 = _mm256_i32gather_pd(arrival, v0, 8);
+      const __m256d arrival1 = _mm256_i32gather_pd(arrival, v1, 8);
+
+      __m256d tardiness0, tardiness1;
+      if constexpr (Sim) {
+         const __m256d startTime = _mm256_max_pd(arrival1, arrival0);
+         tardiness0 = _mm256_max_pd(_mm256_sub_pd(startTime, twMax), zero);
+         tardiness1 = tardiness0;
+      } else {
+         __m256d startTime0 = arrival0;
+         const __m256d startTime1 = _mm256_max_pd(_mm256_add_pd(startTime0, deltaMin), arrival1);
+         const __m256d viol = _mm256_max_pd(_mm256_sub_pd(_mm256_sub_pd(startTime1, startTime0), deltaMax), zero);
+         startTime0 = _mm256_add_pd(startTime0, viol);
+         tardiness0 = _mm256_max_pd(_mm256_sub_pd(startTime0, twMax), zero);
+         tardiness1 = _mm256_max_pd(_mm256_sub_pd(startTime1, twMax), zero);
+      }
+
+      const __m256d dist0 = _mm256_i32gather_pd(dist, v0, 8);
+      const __m256d dist1 = _mm256_i32gather_pd(dist, v1, 8);
+      __m256d incDist;
+      if constexpr (ConvHull) {
+         const __m256d h0 = _mm256_xor_pd(_mm256_i32gather_pd(depot, v0, 8), sign);
+         const __m256d h1 = _mm256_i32gather_pd(depot, v1, 8);
+         incDist = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_add_pd(
+            _mm256_sub_pd(h0, h1), dist0), dist1), depotDist), depotDist);
+      } else {
+         incDist = _mm256_add_pd(dist0, dist1);
+      }
+
+      __m256d c = _mm256_add_pd(_mm256_add_pd(
+         _mm256_mul_pd(c0, _mm256_add_pd(solDist, incDist)),
+         _mm256_mul_pd(c1, _mm256_add_pd(solTard, _mm256_add_pd(tardiness0, tardiness1)))),
+         _mm256_mul_pd(c2, _mm256_max_pd(_mm256_max_pd(tardiness1, tardiness0), solTmax)));
+      if constexpr (Heur)
+         c = _mm256_add_pd(c, _mm256_i32gather_pd(wtime, v1, 8));
+      _mm256_storeu_pd(cost + j, c);
+   }
+
+   pairsScalar<ConvHull, Heur, Sim>(p, n - j, pairs + j, arrival, dist, depot, wtime, cost + j);
+}
+
+template <bool ConvHull>
+__attribute__((target("avx512f")))
+void singleAvx512(const InsertionParams &p, int n, const double *dist,
+      const double *leave, const double *depot, double *cost) {
+   const __m512d zero = _mm512_setzero_pd();
+   const __m512i sign = _mm512_set1_epi64(static_cast<long long>(1ULL << 63));
+   const __m512d twMin = _mm512_set1_pd(p.twMin);
+   const __m512d twMax = _mm512_set1_pd(p.twMax);
+   const __m512d depotDist = _mm512_set1_pd(p.depotDist);
+   const __m512d solDist = _mm512_set1_pd(p.dist);
+   const __m512d solTard = _mm512_set1_pd(p.tard);
+   const __m512d solTmax = _mm512_set1_pd(p.tmax);
+   const __m512d c0 = _mm512_set1_pd(C0), c1 = _mm512_set1_pd(C1), c2 = _mm512_set1_pd(C2);
+
+   int j = 0;
+   for (; j + 8 <= n; j += 8) {
+      const __m512d d = _mm512_loadu_pd(dist + j);
+      const __m512d arrival = _mm512_max_pd(_mm512_add_pd(_mm512_loadu_pd(leave + j), d), twMin);
+      const __m512d tardiness = _mm512_max_pd(_mm512_sub_pd(arrival, twMax), zero);
+
+      __m512d incDist = d;
+      if constexpr (ConvHull) {
+         const __m512d h = _mm512_castsi512_pd(_mm512_xor_si512(
+            _mm512_castpd_si512(_mm512_loadu_pd(depot + j)), sign));
+         incDist = _mm512_add_pd(_mm512_add_pd(h, d), depotDist);
+      }
+
+      const __m512d c = _mm512_add_pd(_mm512_add_pd(
+         _mm512_mul_pd(c0, _mm512_add_pd(solDist, incDist)),
+         _mm512_mul_pd(c1, _mm512_add_pd(solTard, tardiness))),
+         _mm512_mul_pd(c2, _mm512_max_pd(tardiness, solTmax)));
+      _mm512_storeu_pd(cost + j, c);
+   }
+
+   singleScalar<ConvHull>(p, n - j, dist + j, leave + j, ConvHull ? depot + j : depot, cost + j);
+}
+
+template <bool ConvHull, bool Heur, bool Sim>
+__attribute__((target("avx512f")))
+void pairsAvx512(const InsertionParams &p, int n, const Instance::VehiclePair *pairs,
+      const double *arrival, const double *dist, const double *depot,
+      const double *wtime, double *cost) {
+   const __m512d zero = _mm512_setzero_pd();
+   const __m512i sign = _mm512_set1_epi64(static_cast<long long>(1ULL << 63));
+   const __m512d twMax = _mm512_set1_pd(p.twMax);
+   const __m512d deltaMin = _mm512_set1_pd(p.deltaMin);
+   const __m512d deltaMax = _mm512_set1_pd(p.deltaMax);
+   const __m512d depotDist = _mm512_set1_pd(p.depotDist);
+   const __m512d solDist = _mm512_set1_pd(p.dist);
+   const __m512d solTard = _mm512_set1_pd(p.tard);
+   const __m512d solTmax = _mm512_set1_pd(p.tmax);
+   const __m512d c0 = _mm512_set1_pd(C0), c1 = _mm512_set1_pd(C1), c2 = _mm512_set1_pd(C2);
+   const __m512i split = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+   int j = 0;
+   for (; j + 8 <= n; j += 8) {
+      // Splits eight (v0, v1) pairs into vectors of v0 and v1 indices.
+      const __m512i vv = _mm512_permutexvar_epi32(split, _mm512_loadu_si512(pairs + j));
+      const __m256i v0 = _mm512_castsi512_si256(vv);
+      const __m256i v1 = _mm512_extracti64x4_epi64(vv, 1);
+
+      const __m512d arrival0 = _mm512_i32gather_pd(v0, arrival, 8);
+      const __m512d arrival1 = _mm512_i32gather_pd(v1, arrival, 8);
+
+      __m512d tardiness0, tardiness1;
+      if constexpr (Sim) {
+         const __m512d startTime = _mm512_max_pd(arrival1, arrival0);
+         tardiness0 = _mm512_max_pd(_mm512_sub_pd(startTime, twMax), zero);
+         tardiness1 = tardiness0;
+      } else {
+         __m512d startTime0 = arrival0;
+         const __m512d startTime1 = _mm512_max_pd(_mm512_add_pd(startTime0, deltaMin), arrival1);
+         const __m512d viol = _mm512_max_pd(_mm512_sub_pd(_mm512_sub_pd(startTime1, startTime0), deltaMax), zero);
+         startTime0 = _mm512_add_pd(startTime0, viol);
+         tardiness0 = _mm512_max_pd(_mm512_sub_pd(startTime0, twMax), zero);
+         tardiness1 = _mm512_max_pd(_mm512_sub_pd(startTime1, twMax), zero);
+      }
+
+      const __m512d dist0 = _mm512_i32gather_pd(v0, dist, 8);
+      const __m512d dist1 = _mm512_i32gather_pd(v1, dist, 8);
+      __m512d incDist;
+      if constexpr (ConvHull) {
+         const __m512d h0 = _mm512_castsi512_pd(_mm512_xor_si512(
+            _mm512_castpd_si512(_mm512_i32gather_pd(v0, depot, 8)), sign));
+         const __m512d h1 = _mm512_i32gather_pd(v1, depot, 8);
+         incDist = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(_mm512_add_pd(
+            _mm512_sub_pd(h0, h1), dist0), dist1), depotDist), depotDist);
+      } else {
+         incDist = _mm512_add_pd(dist0, dist1);
+      }
+
+      __m512d c = _mm512_add_pd(_mm512_add_pd(
+         _mm512_mul_pd(c0, _mm512_add_pd(solDist, incDist)),
+         _mm512_mul_pd(c1, _mm512_add_pd(solTard, _mm512_add_pd(tardiness0, tardiness1)))),
+         _mm512_mul_pd(c2, _mm512_max_pd(_mm512_max_pd(tardiness1, tardiness0), solTmax)));
+      if constexpr (Heur)
+         c = _mm512_add_pd(c, _mm512_i32gather_pd(v1, wtime, 8));
+      _mm512_storeu_pd(cost + j, c);
+   }
+
+   pairsScalar<ConvHull, Heur, Sim>(p, n - j, pairs + j, arrival, dist, depot, wtime, cost + j);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+// Tables of the specializations of a kernel, indexed as in `InsertionKernels`.
+#define SINGLE_KERNELS(f) {f<false>, f<true>}
+#define PAIR_KERNELS(f) { \
+   {{f<false, false, false>, f<false, false, true>}, {f<false, true, false>, f<false, true, true>}}, \
+   {{f<true, false, false>, f<true, false, true>}, {f<true, true, false>, f<true, true, true>}}}
+
+const char *kernelIsaName(KernelIsa isa) {
+   switch (isa) {
+      case ISA_AUTO: return "auto";
+      case ISA_SCALAR: return "scalar";
+      case ISA_AVX2: return "avx2";
+      case ISA_AVX512: return "avx512";
+   }
+   return "unknown";
+}
+
+}
+
+const InsertionKernels &insertionKernels(KernelIsa isa) {
+   static const InsertionKernels scalar {
+      "scalar", SINGLE_KERNELS(singleScalar), PAIR_KERNELS(pairsScalar)};
+
+#ifdef INSERTION_KERNELS_X86
+   static const InsertionKernels avx2 {
+      "avx2", SINGLE_KERNELS(singleAvx2), PAIR_KERNELS(pairsAvx2)};
+   static const InsertionKernels avx512 {
+      "avx512", SINGLE_KERNELS(singleAvx512), PAIR_KERNELS(pairsAvx512)};
+   const bool hasAvx2 = __builtin_cpu_supports("avx2");
+   const bool hasAvx512 = __builtin_cpu_supports("avx512f");
+
+   switch (isa) {
+      case ISA_AUTO:
+         return hasAvx512 ? avx512 : hasAvx2 ? avx2 : scalar;
+      case ISA_AVX2:
+         if (hasAvx2)
+            return avx2;
+         break;
+      case ISA_AVX512:
+         if (hasAvx512)
+            return avx512;
+         break;
+      default:
+         return scalar;
+   }
+#else
+   if (isa == ISA_AUTO || isa == ISA_SCALAR)
+      return scalar;
+#endif
+
+   throw runtime_error(string("instruction set not supported by the processor: ") + kernelIsaName(isa));
+}
+
+KernelIsa kernelIsaFromName(const std::string &name) {
+   for (auto isa: {ISA_AUTO, ISA_SCALAR, ISA_AVX2, ISA_AVX512}) {
+      if (name == kernelIsaName(isa))
+         return isa;
+   }
+   throw runtime_error("unknown instruction set: " + name);
+}
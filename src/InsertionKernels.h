@@ -0,0 +1,100 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include "Instance.h"
+
+#include <string>
+
+/**
+ * Parameters shared by all candidate assignments of a task: data of the
+ * patient and cost indicators of the partial solution.
+ */
+struct InsertionParams {
+   double twMin;
+   double twMax;
+   double deltaMin;
+   double deltaMax;
+
+   // Distance from the patient to the depot, used by the convex hull variant.
+   double depotDist;
+
+   double dist;
+   double tard;
+   double tmax;
+};
+
+typedef void (*SingleInsertionKernel)(const InsertionParams &p, int n, const double *dist,
+   const double *leave, const double *depot, double *cost);
+
+typedef void (*PairInsertionKernel)(const InsertionParams &p, int n, const Instance::VehiclePair *pairs,
+   const double *arrival, const double *dist, const double *depot,
+   const double *wtime, double *cost);
+
+/**
+ * Kernels that compute the cost of inserting a task for a batch of candidate
+ * assignments, exactly as `DecodeState::insertionCost` (plus the workload
+ * term of the decoder) computes it for each one. Each kernel is specialized
+ * at compile time for the flags of the chromosome and the service type, so
+ * the decoder picks one per decode or per task instead of branching per
+ * candidate.
+ *
+ * `single[convHull]` evaluates vehicles of a single service task. Its inputs
+ * are indexed by candidate: distance from the vehicle position to the
+ * patient, leave time of the vehicle, and distance from the vehicle position
+ * to the depot (only read with the convex hull variant).
+ *
+ * `pairs[convHull][heur][sim]` evaluates (v0, v1) pairs of a double service
+ * task, simultaneous if `sim` or with precedence otherwise. Its inputs are
+ * indexed by vehicle: arrival time at the patient, distance to the patient,
+ * distance to the depot, and the workload of the vehicle, added to the cost
+ * of v1 only if `heur`.
+ */
+struct InsertionKernels {
+   const char *name;
+   SingleInsertionKernel single[2];
+   PairInsertionKernel pairs[2][2][2];
+};
+
+enum KernelIsa {
+   ISA_AUTO,
+   ISA_SCALAR,
+   ISA_AVX2,
+   ISA_AVX512
+};
+
+/**
+ * Kernels for an instruction set. ISA_AUTO picks the widest one supported by
+ * the processor. Throws std::runtime_error if the processor lacks the
+ * requested instruction set.
+ */
+const InsertionKernels &insertionKernels(KernelIsa isa = ISA_AUTO);
+
+KernelIsa kernelIsaFromName(const std::string &name);
@@ -27,127 +27,363 @@
  */
 
 #include "Instance.h"
+#include "Profiler.h"
+#include "TextReader.h"
+
 #include <limits>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
-#include <numeric> // std::accumulate
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
-Instance::Instance(const char* fname) {
+namespace {
+
+/*
+ * Layout of the binary cache format. The header is followed by flat arrays,
+ * each one starting at an offset aligned to `BIN_ALIGN` bytes:
+ *    - vehicle skills,   int32  [numVehicles x numSkills]
+ *    - required skills,  int32  [numNodes x numSkills]
+ *    - service types,    int32  [numNodes]
+ *    - time windows,     double [numNodes] (begin), double [numNodes] (end)
+ *    - separation times, double [numNodes] (min), double [numNodes] (max)
+ *    - processing times, double [numNodes x numSkills]
+ *    - coordinates,      double [numNodes] (x), double [numNodes] (y)
+ *    - distances,        double [numNodes x distStride]
+ * Multi-byte values are stored in the byte order of the machine that wrote
+ * the file; `byteOrder` is used to reject files from a foreign architecture.
+ */
+constexpr char BIN_MAGIC[8] = {'H', 'H', 'C', 'R', 'S', 'P', 'B', '\0'};
+constexpr uint32_t BIN_VERSION = 1;
+constexpr uint32_t BIN_BYTE_ORDER = 0x01020304;
+constexpr uint64_t BIN_ALIGN = 64;
+
+enum BinSection {
+   SEC_VEHICLE_SKILLS = 0,
+   SEC_REQ_SKILLS,
+   SEC_SVC_TYPE,
+   SEC_TW_MIN,
+   SEC_TW_MAX,
+   SEC_DELTA_MIN,
+   SEC_DELTA_MAX,
+   SEC_PROC_TIME,
+   SEC_POS_X,
+   SEC_POS_Y,
+   SEC_DISTANCES,
+   SEC_COUNT
+};
+
+struct BinHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t byteOrder;
+   int32_t numNodes;
+   int32_t numVehicles;
+   int32_t numSkills;
+   int32_t distStride;
+   uint64_t fileSize;
+   uint64_t offset[SEC_COUNT];
+};
+
+uint64_t alignUp(uint64_t value) {
+   return (value + BIN_ALIGN - 1) / BIN_ALIGN * BIN_ALIGN;
+}
+
+// Computes the offsets of all sections, and returns the total file size.
+uint64_t binLayout(BinHeader &hdr) {
+   const uint64_t n = hdr.numNodes, v = hdr.numVehicles, s = hdr.numSkills;
+   const uint64_t sizes[SEC_COUNT] = {
+      v*s*sizeof(int32_t),
+      n*s*sizeof(int32_t),
+      n*sizeof(int32_t),
+      n*sizeof(double),
+      n*sizeof(double),
+      n*sizeof(double),
+      n*sizeof(double),
+      n*s*sizeof(double),
+      n*sizeof(double),
+      n*sizeof(double),
+      n*hdr.distStride*sizeof(double)
+   };
+   uint64_t pos = alignUp(sizeof(BinHeader));
+   for (int k = 0; k < SEC_COUNT; ++k) {
+      hdr.offset[k] = pos;
+      pos = alignUp(pos + sizes[k]);
+   }
+   return pos;
+}
+
+} // namespace
+
+Instance::Instance(const char* fname, DistanceKind distKind):
+   m_distances(nullptr), m_distStride(0), m_distKind(DIST_DENSE), m_distTri(nullptr) {
+
+   PROFILE_ZONE("parse");
    m_fname = fname;
-   std::ifstream fid(fname);
-   if (!fid) {
-      std::cout << "Instance file " << fname << " could not be read." << std::endl;
-      std::exit(EXIT_FAILURE);
+   if (isBinaryFile(fname)) {
+      readBinary(fname);
+      selectDistanceProvider(distKind, [&] (int first, int last, double *rows, int stride) {
+         for (int i = first; i < last; ++i) {
+            const double *src = m_distances + size_t(i)*m_distStride;
+            std::copy(src, src + m_numNodes, rows + size_t(i - first)*stride);
+         }
+      });
+   } else {
+      readText(fname, distKind);
    }
+   buildCaches();
+}
+
+void Instance::readText(const char *fname, DistanceKind distKind) {
+   TextReader reader(fname);
+
+   const std::vector<std::string> sections = {
+      "nbNodes", "nbVehi", "nbServi", "r", "DS", "a", "x", "y", "d", "p", "mind", "maxd", "e", "l"
+   };
+   std::vector<bool> seen(sections.size(), false);
+   auto wasSeen = [&] (const char *name) {
+      return seen[std::find(sections.begin(), sections.end(), name) - sections.begin()];
+   };
+   auto requireSeen = [&] (const char *name, int line) {
+      if (!wasSeen(name))
+         reader.fail(line, std::string("section must appear after section '") + name + "'");
+   };
+
+   // Parses the rows of a matrix section, one row per line, in parallel.
+   // Returns the index of the first malformed row, or -1 if all are correct.
+   auto parseRows = [&] (const std::vector<std::string_view> &rows, int count, auto &&store) {
+      std::vector<int> status(rows.size());
+      #pragma omp parallel for schedule(static) if(rows.size() >= 128)
+      for (int i = 0; i < int(rows.size()); ++i) {
+         status[i] = store(i, rows[i]) == count ? -1 : i;
+      }
+      for (int st: status)
+         if (st != -1)
+            return st;
+      return -1;
+   };
 
    std::vector <int> dscheck;
-   std::string buf, lastenv;
-   while (std::getline(fid, buf)) {
-      if (buf.length() == 0 || buf.find_first_not_of(" ") == std::string::npos) {
+   int dsLine = 0;
+
+   // The distances are stored once the coordinates are known, as the
+   // backend chosen may depend on them. Rows spanning several lines are
+   // read with the tokenizer from `distStart`, and the others parsed in
+   // parallel from `distRows`.
+   TextReader::Mark distStart{};
+   std::vector <std::string_view> distRows;
+   std::vector <int> distRowLine;
+   bool distStored = false;
+   auto readDistRows = [&] (int first, int last, double *rows, int stride) {
+      if (distRows.empty()) {
+         if (first == 0)
+            reader.reset(distStart);
+         for (int i = first; i < last; ++i)
+            for (int j = 0; j < m_numNodes; ++j)
+               rows[size_t(i - first)*stride + j] = reader.next<double>("a distance");
+         return;
+      }
+
+      std::vector<int> status(last - first);
+      #pragma omp parallel for schedule(static) if(last - first >= 128)
+      for (int i = first; i < last; ++i) {
+         const int cnt = TextReader::parseLine(distRows[i], rows + size_t(i - first)*stride, m_numNodes);
+         status[i - first] = cnt == m_numNodes ? -1 : i;
+      }
+      for (int bad: status) {
+         if (bad != -1) {
+            reader.fail(distRowLine[bad], "expected " + std::to_string(m_numNodes) +
+               " distances in row " + std::to_string(bad));
+         }
+      }
+   };
+
+   while (!reader.eof()) {
+      int line;
+      std::string_view buf = reader.nextLine(&line);
+      while (!buf.empty() && isBlank(buf.back()))
+         buf.remove_suffix(1);
+
+      if (buf.empty()) {
          // Skip empty lines
-      } else if (buf == "nbNodes") {
-         lastenv = buf;
-         fid >> m_numNodes;
+         continue;
+      }
+
+      auto secIt = std::find(sections.begin(), sections.end(), buf);
+      if (secIt == sections.end()) {
+         reader.fail(line, "unknown line content '" + std::string(buf) + "'");
+      }
+      reader.setSection(*secIt);
+      seen[secIt - sections.begin()] = true;
+
+      if (buf == "nbNodes") {
+         m_numNodes = reader.next<int>("the number of nodes");
+         reader.finishLine();
+         if (m_numNodes < 2)
+            reader.fail(line, "instances require at least two depot nodes");
       } else if (buf == "nbVehi") {
-         lastenv = buf;
-         fid >> m_numVehicles;
+         m_numVehicles = reader.next<int>("the number of vehicles");
+         reader.finishLine();
+         if (m_numVehicles < 1)
+            reader.fail(line, "instances require at least one vehicle");
       } else if (buf == "nbServi") {
-         lastenv = buf;
-         fid >> m_numSkills;
+         requireSeen("nbNodes", line);
+         requireSeen("nbVehi", line);
+         m_numSkills = reader.next<int>("the number of service types");
+         reader.finishLine();
+         if (m_numSkills < 1 || m_numSkills > MAX_SKILLS) {
+            reader.fail(line, "the number of service types must be within [1, " +
+               std::to_string(MAX_SKILLS) + "]");
+         }
          resize();
       } else if (buf == "r") {
-         lastenv = buf;
-         for (auto &i: m_nodeReqSkills)
-            for (auto &s: i)
-               fid >> s;
+         requireSeen("nbServi", line);
+         for (auto &mask: m_nodeReqSkills) {
+            for (int s = 0; s < m_numSkills; ++s) {
+               int val = reader.next<int>("a service requirement");
+               mask |= uint64_t(val != 0) << s;
+            }
+         }
+         reader.finishLine();
       } else if (buf == "DS") {
-         lastenv = buf;
-         std::getline(fid, buf);
-         std::stringstream stream(buf);
-         int id;
-         while (stream >> id) {
+         requireSeen("nbServi", line);
+         std::string_view ids = reader.nextLine(&dsLine);
+         const char *ptr = ids.data(), *last = ids.data() + ids.size();
+         while (true) {
+            while (ptr < last && isBlank(*ptr))
+               ++ptr;
+            if (ptr == last)
+               break;
+            int id;
+            ptr = TextReader::parseNumber(ptr, last, id);
+            if (ptr == nullptr || id < 2 || id > m_numNodes-1)
+               reader.fail(dsLine, "invalid double service node identifier");
             dscheck.push_back(id-1);
          }
-         for (int i = 1; i < m_numNodes-1; ++i) {
-            if (std::find(dscheck.begin(), dscheck.end(), i) != dscheck.end()) {
-               continue;
-            }
-            m_nodeSvcType[i] = SvcType::SINGLE;
-
-            int sksum = std::accumulate(m_nodeReqSkills[i].begin(), m_nodeReqSkills[i].end(), 0);
-            if (sksum != 1) {
-               std::cout << "Single service node " << i << " requiring a invalid amount of "
-                  << sksum << " service types." << std::endl;
-               std::abort();
+      } else if (buf == "a") {
+         requireSeen("nbServi", line);
+         for (auto &mask: m_vehicleSkills) {
+            for (int s = 0; s < m_numSkills; ++s) {
+               int val = reader.next<int>("a vehicle qualification");
+               mask |= uint64_t(val != 0) << s;
             }
          }
-      } else if (buf == "a") {
-         lastenv = buf;
-         for (auto &v: m_vehicleSkills)
-            for (auto &s: v)
-               fid >> s;
-      } else if (buf == "x") {
-         lastenv = buf;
-         for (int i = 0; i < m_numNodes; ++i)
-            fid >> std::get<0>(m_nodePos[i]);
-      } else if (buf == "y") {
-         lastenv = buf;
-         for (int i = 0; i < m_numNodes; ++i)
-            fid >> std::get<1>(m_nodePos[i]);
+         reader.finishLine();
       } else if (buf == "d") {
-         lastenv = buf;
-         for (int i = 0; i < m_numNodes; ++i)
-            for (int j = 0; j < m_numNodes; ++j)
-               fid >> m_distances[i][j];
+         requireSeen("nbServi", line);
+         distStart = reader.mark();
+
+         // Matrices written with one row per line are parsed in parallel.
+         distRows.clear();
+         distRowLine.clear();
+         while (int(distRows.size()) < m_numNodes && !reader.eof()) {
+            int ln;
+            auto row = reader.nextLine(&ln);
+            if (row.find_first_not_of(" \t\r") == std::string_view::npos)
+               continue;
+            distRows.push_back(row);
+            distRowLine.push_back(ln);
+         }
+
+         std::vector<double> row0(m_numNodes);
+         const bool rowPerLine = int(distRows.size()) == m_numNodes &&
+            TextReader::parseLine(distRows[0], row0.data(), m_numNodes) == m_numNodes;
+         if (!rowPerLine) {
+            // Otherwise, rows may span several lines.
+            distRows.clear();
+            reader.reset(distStart);
+         }
+
+         if (wasSeen("x") && wasSeen("y")) {
+            selectDistanceProvider(distKind, readDistRows);
+            distStored = true;
+         } else if (!rowPerLine) {
+            for (size_t k = 0; k < size_t(m_numNodes)*m_numNodes; ++k)
+               reader.next<double>("a distance");
+         }
+         if (!rowPerLine)
+            reader.finishLine();
       } else if (buf == "p") {
-         lastenv = buf;
+         requireSeen("nbServi", line);
+         std::vector <std::string_view> rows(m_numNodes);
+         std::vector <int> rowLine(m_numNodes);
          for (int i = 0; i < m_numNodes; ++i) {
             for (int v = 0; v < m_numVehicles; ++v) {
-               std::getline(fid, buf);
+               if (reader.eof())
+                  reader.fail("unexpected end of file while reading the processing times");
+               int ln;
+               auto row = reader.nextLine(&ln);
                // Use only processing time of first vehicle.
                // This is a issue with the instance format.
-               if (v != 0)
-                  continue;
-               std::stringstream stream(buf);
-               for (int s = 0; s < m_numSkills; ++s) {
-                  stream >> m_nodeProcTime[i][s];
+               if (v == 0) {
+                  rows[i] = row;
+                  rowLine[i] = ln;
                }
             }
          }
-      } else if (buf == "mind") {
-         lastenv = buf;
-         for (auto &i: m_nodeDelta)
-            fid >> std::get<0>(i);
-      } else if (buf == "maxd") {
-         lastenv = buf;
-         for (auto &i: m_nodeDelta)
-            fid >> std::get<1>(i);
-      } else if (buf == "e") {
-         lastenv = buf;
-         for (auto &i: m_nodeTw)
-            fid >> std::get<0>(i);
-      } else if (buf == "l") {
-         lastenv = buf;
-         for (auto &i: m_nodeTw)
-            fid >> std::get<1>(i);
+
+         int bad = parseRows(rows, m_numSkills, [&] (int i, std::string_view row) {
+            double vals[MAX_SKILLS];
+            int cnt = TextReader::parseLine(row, vals, m_numSkills);
+            for (int s = 0; s < std::min(cnt, m_numSkills); ++s)
+               m_nodeProcTime[s*m_nodeStride + i] = vals[s];
+            return cnt;
+         });
+         if (bad != -1) {
+            reader.fail(rowLine[bad], "expected " + std::to_string(m_numSkills) +
+               " processing times for node " + std::to_string(bad));
+         }
       } else {
-         std::cout << "Unknow line content: " << buf << std::endl;
-         std::cout << "Line length: " << buf.length() << std::endl;
-         std::cout << "Last section read: " << lastenv << std::endl;
-         std::exit(EXIT_FAILURE);
+         // Sections with one value per node.
+         requireSeen("nbServi", line);
+         auto &values = buf == "x" ? m_nodePosX : buf == "y" ? m_nodePosY :
+            buf == "mind" ? m_nodeDeltaMin : buf == "maxd" ? m_nodeDeltaMax :
+            buf == "e" ? m_nodeTwMin : m_nodeTwMax;
+         for (int i = 0; i < m_numNodes; ++i)
+            values[i] = reader.next<double>("a node attribute");
+         reader.finishLine();
       }
    }
 
-   fid.close();
+   for (size_t k = 0; k < sections.size(); ++k) {
+      if (!seen[k]) {
+         reader.setSection(sections[k]);
+         reader.fail("section is missing");
+      }
+   }
+
+   // The coordinates were missing when the matrix was reached.
+   if (!distStored) {
+      reader.setSection("d");
+      selectDistanceProvider(distKind, readDistRows);
+   }
+
+   reader.setSection("DS");
+   for (int i = 1; i < m_numNodes-1; ++i) {
+      if (std::find(dscheck.begin(), dscheck.end(), i) != dscheck.end()) {
+         continue;
+      }
+      m_nodeSvcType[i] = SvcType::SINGLE;
+
+      int sksum = __builtin_popcountll(m_nodeReqSkills[i]);
+      if (sksum != 1) {
+         reader.fail(dsLine, "single service node " + std::to_string(i) + " requiring a invalid amount of " +
+            std::to_string(sksum) + " service types");
+      }
+   }
 
    // Detect service type of double service nodes.
    for (int i: dscheck) {
-      int sksum = std::accumulate(m_nodeReqSkills[i].begin(), m_nodeReqSkills[i].end(), 0);
-      int dmin = std::get<0>(m_nodeDelta[i]);
+      int sksum = __builtin_popcountll(m_nodeReqSkills[i]);
+      int dmin = m_nodeDeltaMin[i];
 
       if (sksum == 2) {
          if (dmin <= 0.001) {
@@ -156,32 +392,145 @@ Instance::Instance(const char* fname) {
             m_nodeSvcType[i] = SvcType::PRED;
          }
       } else {
-         std::cout << "Double service node " << i << " requiring a invalid amount of "
-            << sksum << " service types." << std::endl;
-         std::abort();
+         reader.fail(dsLine, "double service node " + std::to_string(i) + " requiring a invalid amount of " +
+            std::to_string(sksum) + " service types");
       }
    }
+}
 
-   // Build the caches.
-   m_nodeSkills.resize(numNodes());
-   m_vehiSkills.resize(numVehicles());
-   m_qualifVehi.resize(numSkills());
+void Instance::readBinary(const char *fname) {
+   int fd = open(fname, O_RDONLY);
+   struct stat st;
+   if (fd == -1 || fstat(fd, &st) == -1) {
+      const std::string err = strerror(errno);
+      if (fd != -1)
+         close(fd);
+      throw std::runtime_error(std::string(fname) + ": could not be read: " + err);
+   }
+
+   const size_t len = st.st_size;
+   void *addr = len >= sizeof(BinHeader) ? mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+   close(fd);
+   if (addr == MAP_FAILED) {
+      throw std::runtime_error(std::string(fname) + ": binary instance could not be mapped into memory");
+   }
+   std::shared_ptr<const void> mapping(addr, [len] (const void *ptr) {
+      munmap(const_cast<void*>(ptr), len);
+   });
+
+   const char *base = static_cast<const char*>(addr);
+   BinHeader hdr;
+   std::memcpy(&hdr, base, sizeof(hdr));
+
+   BinHeader expected = hdr;
+   if (hdr.version != BIN_VERSION || hdr.byteOrder != BIN_BYTE_ORDER || hdr.numNodes <= 0 ||
+         hdr.numVehicles <= 0 || hdr.numSkills <= 0 || hdr.numSkills > MAX_SKILLS || hdr.distStride < hdr.numNodes ||
+         hdr.fileSize != len || binLayout(expected) != len ||
+         std::memcmp(expected.offset, hdr.offset, sizeof(hdr.offset)) != 0) {
+      throw std::runtime_error(std::string(fname) + ": binary instance is corrupted or was written by "
+         "an incompatible version (expected version " + std::to_string(BIN_VERSION) + ", found " +
+         std::to_string(hdr.version) + ")");
+   }
 
+   // The distance matrix is not copied, but used straight from the mapping.
+   m_distBlock = mapping;
+   m_distStride = hdr.distStride;
+   m_distances = reinterpret_cast<const double*>(base + hdr.offset[SEC_DISTANCES]);
+
+   resize(hdr.numNodes, hdr.numVehicles, hdr.numSkills);
+
+   auto section = [&] (BinSection sec) {
+      return base + hdr.offset[sec];
+   };
+   auto readArray = [&] (BinSection sec, int idx, auto &value) {
+      std::memcpy(&value, section(sec) + idx*sizeof(value), sizeof(value));
+   };
+
+   for (int v = 0; v < m_numVehicles; ++v) {
+      for (int s = 0; s < m_numSkills; ++s) {
+         int32_t val;
+         readArray(SEC_VEHICLE_SKILLS, v*m_numSkills + s, val);
+         m_vehicleSkills[v] |= uint64_t(val != 0) << s;
+      }
+   }
+
+   for (int i = 0; i < m_numNodes; ++i) {
+      int32_t val;
+      for (int s = 0; s < m_numSkills; ++s) {
+         readArray(SEC_REQ_SKILLS, i*m_numSkills + s, val);
+         m_nodeReqSkills[i] |= uint64_t(val != 0) << s;
+         readArray(SEC_PROC_TIME, i*m_numSkills + s, m_nodeProcTime[s*m_nodeStride + i]);
+      }
+      readArray(SEC_SVC_TYPE, i, val);
+      m_nodeSvcType[i] = static_cast<SvcType>(val);
+      readArray(SEC_TW_MIN, i, m_nodeTwMin[i]);
+      readArray(SEC_TW_MAX, i, m_nodeTwMax[i]);
+      readArray(SEC_DELTA_MIN, i, m_nodeDeltaMin[i]);
+      readArray(SEC_DELTA_MAX, i, m_nodeDeltaMax[i]);
+      readArray(SEC_POS_X, i, m_nodePosX[i]);
+      readArray(SEC_POS_Y, i, m_nodePosY[i]);
+   }
+}
+
+void Instance::buildCaches() {
+   m_nodeSkills.clear();
+   m_nodeSkillsOff.assign(1, 0);
    for (int i = 0; i < numNodes(); ++i) {
       for (int s = 0; s < numSkills(); ++s) {
          if (nodeReqSkill(i, s)) {
-            m_nodeSkills[i].push_back(s);
+            m_nodeSkills.push_back(s);
          }
       }
+      m_nodeSkillsOff.push_back(m_nodeSkills.size());
    }
 
+   m_vehiSkills.clear();
+   m_vehiSkillsOff.assign(1, 0);
    for (int v = 0; v < numVehicles(); ++v) {
       for (int s = 0; s < numSkills(); ++s) {
          if (vehicleHasSkill(v, s)) {
-            m_vehiSkills[v].push_back(s);
-            m_qualifVehi[s].push_back(v);
+            m_vehiSkills.push_back(s);
          }
       }
+      m_vehiSkillsOff.push_back(m_vehiSkills.size());
+   }
+
+   m_qualifVehi.clear();
+   m_qualifVehiOff.assign(1, 0);
+   for (int s = 0; s < numSkills(); ++s) {
+      for (int v = 0; v < numVehicles(); ++v) {
+         if (vehicleHasSkill(v, s)) {
+            m_qualifVehi.push_back(v);
+         }
+      }
+      m_qualifVehiOff.push_back(m_qualifVehi.size());
+   }
+
+   // Enumerates the vehicle pairs of each combination of skills required
+   // by double service nodes. Combinations are enumerated only once.
+   m_vehiPairs.clear();
+   m_nodePairsOff.assign(2*numNodes(), 0);
+   std::vector <int> comboBegin(numSkills()*numSkills(), -1);
+   std::vector <int> comboEnd(numSkills()*numSkills(), -1);
+   for (int i = 0; i < numNodes(); ++i) {
+      if (nodeSkills(i).size() != 2)
+         continue;
+
+      const int s0 = nodeSkills(i)[0], s1 = nodeSkills(i)[1];
+      const int combo = s0*numSkills() + s1;
+      if (comboBegin[combo] == -1) {
+         comboBegin[combo] = m_vehiPairs.size();
+         for (int v0: qualifiedVehicles(s0)) {
+            for (int v1: qualifiedVehicles(s1)) {
+               if (v0 != v1)
+                  m_vehiPairs.push_back(VehiclePair{v0, v1});
+            }
+         }
+         comboEnd[combo] = m_vehiPairs.size();
+      }
+
+      m_nodePairsOff[2*i] = comboBegin[combo];
+      m_nodePairsOff[2*i+1] = comboEnd[combo];
    }
 }
 
@@ -189,60 +538,146 @@ Instance::~Instance() {
    // Empty by design
 }
 
-int Instance::numVehicles() const {
-   return m_numVehicles;
-}
+void Instance::selectDistanceProvider(DistanceKind kind, const DistanceRows &readRows) {
+   const int n = numNodes();
+
+   // Text instances allocate the dense matrix only here.
+   auto storeDense = [&] () {
+      if (!m_distances) {
+         auto dist = std::make_shared<AlignedVector<double>>(size_t(n)*m_distStride,
+            std::numeric_limits<double>::infinity());
+         readRows(0, n, dist->data(), m_distStride);
+         m_distances = dist->data();
+         m_distBlock = dist;
+      }
+      m_distKind = DIST_DENSE;
+   };
 
-int Instance::numNodes() const {
-   return m_numNodes;
-}
+   const bool fitsDense = size_t(n)*m_distStride*sizeof(double) <= DIST_AUTO_DENSE_LIMIT;
+   if (kind == DIST_DENSE || (kind == DIST_AUTO && fitsDense)) {
+      storeDense();
+      return;
+   }
 
-int Instance::numSkills() const {
-   return m_numSkills;
-}
+   // The triangle is filled while checking which of the compact backends
+   // suit the instance data, a block of rows at a time. The lower part of
+   // each row is compared against the upper part already stored, so the
+   // symmetry is checked in single precision.
+   std::vector<int64_t> triRowOff;
+   std::shared_ptr<AlignedVector<float>> tri;
+   if (kind != DIST_EUCLIDEAN) {
+      triRowOff.resize(n);
+      int64_t off = 0;
+      for (int i = 0; i < n; ++i) {
+         triRowOff[i] = off - i;
+         off += n - i;
+      }
+      tri = std::make_shared<AlignedVector<float>>(off);
+   }
 
-bool Instance::vehicleHasSkill(int vehicle, int skill) const {
-   return m_vehicleSkills[vehicle][skill];
-}
+   constexpr int BLOCK_ROWS = 64;
+   std::vector<double> rows(size_t(BLOCK_ROWS)*n);
+   bool symmetric = true;
+   double euclidDev = 0.0;
+   for (int first = 0; first < n; first += BLOCK_ROWS) {
+      const int last = std::min(n, first + BLOCK_ROWS);
+      readRows(first, last, rows.data(), n);
+
+      #pragma omp parallel for schedule(static) reduction(max: euclidDev)
+      for (int i = first; i < last; ++i) {
+         const double *row = &rows[size_t(i - first)*n];
+         for (int j = 0; j < n; ++j) {
+            const double dx = nodePosX(i) - nodePosX(j), dy = nodePosY(i) - nodePosY(j);
+            euclidDev = std::max(euclidDev, std::abs(row[j] - std::sqrt(dx*dx + dy*dy)));
+         }
+         if (tri) {
+            for (int j = i; j < n; ++j)
+               (*tri)[triRowOff[i] + j] = row[j];
+         }
+      }
 
-bool Instance::nodeReqSkill(int node, int skill) const {
-   return m_nodeReqSkills[node][skill];
-}
+      if (tri) {
+         #pragma omp parallel for schedule(static) reduction(&&: symmetric)
+         for (int i = first; i < last; ++i) {
+            const double *row = &rows[size_t(i - first)*n];
+            for (int j = 0; j < i; ++j)
+               symmetric = symmetric && float(row[j]) == (*tri)[triRowOff[j] + i];
+         }
+      }
 
-Instance::SvcType Instance::nodeSvcType(int node) const {
-   return m_nodeSvcType[node];
-}
+      // Neither compact backend suits the instance.
+      if (kind == DIST_AUTO && !symmetric && euclidDev > DIST_EUCLIDEAN_TOL)
+         break;
+   }
+   const bool euclidean = euclidDev <= DIST_EUCLIDEAN_TOL;
+
+   if (kind == DIST_AUTO) {
+      if (euclidean)
+         kind = DIST_EUCLIDEAN;
+      else if (symmetric)
+         kind = DIST_TRIANGULAR;
+      else
+         kind = DIST_DENSE;
+   }
 
-double Instance::nodeDeltaMin(int node) const {
-   return std::get<0>(m_nodeDelta[node]);
-}
+   if (kind == DIST_TRIANGULAR) {
+      if (!symmetric)
+         throw std::runtime_error(m_fname + ": triangular distances require a symmetric matrix");
 
-double Instance::nodeDeltaMax(int node) const {
-   return std::get<1>(m_nodeDelta[node]);
-}
+      m_distTriRowOff = std::move(triRowOff);
+      m_distTri = tri->data();
+      m_distBlock = tri;
+      m_distances = nullptr;
 
-double Instance::nodeTwMin(int node) const {
-   return std::get<0>(m_nodeTw[node]);
-}
+   } else if (kind == DIST_EUCLIDEAN) {
+      if (!euclidean) {
+         throw std::runtime_error(m_fname + ": distances differ from the euclidean distances by up to " +
+            std::to_string(euclidDev));
+      }
+      m_distBlock.reset();
+      m_distances = nullptr;
+
+   } else {
+      // The rows are read again into the dense matrix.
+      tri.reset();
+      storeDense();
+      return;
+   }
 
-double Instance::nodeTwMax(int node) const {
-   return std::get<1>(m_nodeTw[node]);
+   m_distKind = kind;
 }
 
-double Instance::nodeProcTime(int node, int skill) const {
-   return m_nodeProcTime[node][skill];
+Instance::DistanceKind Instance::distanceKind() const {
+   return m_distKind;
 }
 
-double Instance::nodePosX(int node) const {
-   return std::get<0>(m_nodePos[node]);
+size_t Instance::distanceBytes() const {
+   switch (m_distKind) {
+      case DIST_TRIANGULAR:
+         return (m_distTriRowOff.back() + numNodes())*sizeof(float) + m_distTriRowOff.size()*sizeof(int64_t);
+      case DIST_EUCLIDEAN:
+         return 0;
+      default:
+         return size_t(numNodes())*m_distStride*sizeof(double);
+   }
 }
 
-double Instance::nodePosY(int node) const {
-   return std::get<1>(m_nodePos[node]);
+const char *Instance::distanceKindName(DistanceKind kind) {
+   switch (kind) {
+      case DIST_AUTO: return "auto";
+      case DIST_DENSE: return "dense";
+      case DIST_TRIANGULAR: return "triangular";
+      case DIST_EUCLIDEAN: return "euclidean";
+   }
+   return "unknown";
 }
 
-double Instance::distance(int fromNode, int toNode) const {
-   return m_distances[fromNode][toNode];
+Instance::DistanceKind Instance::distanceKindFromName(const std::string &name) {
+   for (auto kind: {DIST_AUTO, DIST_DENSE, DIST_TRIANGULAR, DIST_EUCLIDEAN}) {
+      if (name == distanceKindName(kind))
+         return kind;
+   }
+   throw std::runtime_error("unknown distance backend: " + name);
 }
 
 const std::string & Instance::fileName() const {
@@ -250,31 +685,30 @@ const std::string & Instance::fileName() const {
 }
 
 void Instance::resize() {
-   m_vehicleSkills.resize(m_numVehicles);
-   for (auto &row: m_vehicleSkills)
-      row.resize(m_numSkills, 0);
-
-   m_nodeReqSkills.resize(m_numNodes);
-   for (auto &row: m_nodeReqSkills)
-      row.resize(m_numSkills, 0);
-
-   m_nodeSvcType.resize(m_numNodes, SvcType::NONE);
+   m_vehicleSkills.assign(m_numVehicles, 0);
+   m_nodeReqSkills.assign(m_numNodes, 0);
 
+   // Per-node arrays are padded, so that vectorized loops may safely
+   // process whole cache lines.
+   m_nodeStride = padToCacheLine<double>(m_numNodes);
+   m_nodeSvcType.assign(m_nodeStride, SvcType::NONE);
 
    const double dblInf = std::numeric_limits<double>::infinity();
-   m_nodeDelta.resize(m_numNodes, std::make_tuple(-dblInf, dblInf));
+   m_nodeDeltaMin.assign(m_nodeStride, -dblInf);
+   m_nodeDeltaMax.assign(m_nodeStride, dblInf);
 
-   m_nodeTw.resize(m_numNodes, std::make_tuple(-dblInf, dblInf));
+   m_nodeTwMin.assign(m_nodeStride, -dblInf);
+   m_nodeTwMax.assign(m_nodeStride, dblInf);
 
-   m_nodeProcTime.resize(m_numNodes);
-   for (auto &row: m_nodeProcTime)
-      row.resize(m_numSkills, dblInf);
+   m_nodeProcTime.assign(m_numSkills*m_nodeStride, dblInf);
 
-   m_nodePos.resize(m_numNodes, std::make_tuple(-dblInf, dblInf));
+   m_nodePosX.assign(m_nodeStride, -dblInf);
+   m_nodePosY.assign(m_nodeStride, dblInf);
 
-   m_distances.resize(m_numNodes);
-   for (auto &row: m_distances)
-      row.resize(m_numNodes, dblInf);
+   // Binary instances bind the distance matrix to the file mapping beforehand,
+   // while text ones allocate it once the distance backend is chosen.
+   if (!m_distances)
+      m_distStride = padToCacheLine<double>(m_numNodes);
 }
 
 void Instance::resize(int numNodes, int numVehicles, int numSkills) {
@@ -285,6 +719,127 @@ void Instance::resize(int numNodes, int numVehicles, int numSkills) {
    resize();
 }
 
+bool Instance::isBinaryFile(const char *fname) {
+   char magic[sizeof(BIN_MAGIC)] = {0};
+   std::ifstream fid(fname, std::ios::binary);
+   fid.read(magic, sizeof(magic));
+   return fid && std::memcmp(magic, BIN_MAGIC, sizeof(magic)) == 0;
+}
+
+void Instance::writeBinary(const char *fname) const {
+   // The compact backends do not keep the exact matrix of the instance.
+   if (!m_distances) {
+      throw std::runtime_error(std::string(fname) + ": binary instance needs the dense distance "
+         "matrix, but the instance was loaded with the " + distanceKindName(m_distKind) + " backend");
+   }
+
+   BinHeader hdr;
+   std::memset(&hdr, 0, sizeof(hdr));
+   std::memcpy(hdr.magic, BIN_MAGIC, sizeof(BIN_MAGIC));
+   hdr.version = BIN_VERSION;
+   hdr.byteOrder = BIN_BYTE_ORDER;
+   hdr.numNodes = m_numNodes;
+   hdr.numVehicles = m_numVehicles;
+   hdr.numSkills = m_numSkills;
+   hdr.distStride = m_distStride;
+   hdr.fileSize = binLayout(hdr);
+
+   std::ofstream fid(fname, std::ios::binary | std::ios::trunc);
+   if (!fid) {
+      throw std::runtime_error(std::string(fname) + ": binary instance could not be created");
+   }
+
+   auto seek = [&] (BinSection sec) {
+      fid.seekp(hdr.offset[sec]);
+   };
+   auto put = [&] (auto value) {
+      fid.write(reinterpret_cast<const char*>(&value), sizeof(value));
+   };
+
+   fid.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+
+   seek(SEC_VEHICLE_SKILLS);
+   for (int v = 0; v < numVehicles(); ++v)
+      for (int s = 0; s < numSkills(); ++s)
+         put(int32_t(vehicleHasSkill(v, s)));
+
+   seek(SEC_REQ_SKILLS);
+   for (int i = 0; i < numNodes(); ++i)
+      for (int s = 0; s < numSkills(); ++s)
+         put(int32_t(nodeReqSkill(i, s)));
+
+   seek(SEC_SVC_TYPE);
+   for (int i = 0; i < numNodes(); ++i)
+      put(int32_t(nodeSvcType(i)));
+
+   const std::tuple<BinSection, double (Instance::*)(int) const> perNode[] = {
+      {SEC_TW_MIN, &Instance::nodeTwMin},
+      {SEC_TW_MAX, &Instance::nodeTwMax},
+      {SEC_DELTA_MIN, &Instance::nodeDeltaMin},
+      {SEC_DELTA_MAX, &Instance::nodeDeltaMax},
+      {SEC_POS_X, &Instance::nodePosX},
+      {SEC_POS_Y, &Instance::nodePosY}
+   };
+   for (auto [sec, getter]: perNode) {
+      seek(sec);
+      for (int i = 0; i < numNodes(); ++i)
+         put((this->*getter)(i));
+   }
+
+   seek(SEC_PROC_TIME);
+   for (int i = 0; i < numNodes(); ++i)
+      for (int s = 0; s < numSkills(); ++s)
+         put(nodeProcTime(i, s));
+
+   // Rows are copied as stored, with zeros in the padding columns.
+   seek(SEC_DISTANCES);
+   std::vector<double> row(hdr.distStride, 0.0);
+   for (int i = 0; i < numNodes(); ++i) {
+      const double *src = m_distances + size_t(i)*m_distStride;
+      std::copy(src, src + numNodes(), row.begin());
+      fid.write(reinterpret_cast<const char*>(row.data()), row.size()*sizeof(double));
+   }
+
+   // Pads the file up to its declared size.
+   fid.seekp(hdr.fileSize - 1);
+   fid.put('\0');
+
+   if (!fid) {
+      throw std::runtime_error(std::string(fname) + ": error writing binary instance");
+   }
+}
+
+vector<int> Instance::nearestPredecessors(int count) const {
+   const int patients = numNodes() - 2;
+
+   // Earliest time a caregiver may leave each patient, assuming the
+   // quickest of its services starts at the opening of the time window.
+   vector<double> earliestLeave(numNodes(), 0.0);
+   for (int i = 1; i <= patients; ++i) {
+      double proc = numeric_limits<double>::infinity();
+      for (int s: nodeSkills(i))
+         proc = min(proc, nodeProcTime(i, s));
+      earliestLeave[i] = nodeTwMin(i) + proc;
+   }
+
+   vector<int> lists(static_cast<size_t>(numNodes()) * count, -1);
+   vector<pair<double,int>> cand;
+   cand.reserve(patients);
+   for (int j = 1; j <= patients; ++j) {
+      cand.clear();
+      for (int i = 1; i <= patients; ++i) {
+         if (i != j && earliestLeave[i] + distance(i, j) <= nodeTwMax(j))
+            cand.emplace_back(distance(i, j), i);
+      }
+
+      const int k = min(count, static_cast<int>(cand.size()));
+      partial_sort(cand.begin(), cand.begin() + k, cand.end());
+      for (int n = 0; n < k; ++n)
+         lists[static_cast<size_t>(j) * count + n] = cand[n].second;
+   }
+   return lists;
+}
+
 std::ostream &operator<<(std::ostream &out, const Instance &inst) {
    out << "nbNodes\n" << inst.numNodes() << "\n";
    out << "nbVehi\n" << inst.numVehicles() << "\n";
@@ -387,16 +942,3 @@ std::ostream &operator<<(std::ostream &out, const Instance &inst) {
 
    return out;
 }
-
-const std::vector <int> Instance::nodeSkills(int node) const { 
-   return m_nodeSkills[node];
-}
-
-const std::vector <int> Instance::vehiSkills(int vehi) const {
-   return m_vehiSkills[vehi];
-}
-
-const std::vector <int> Instance::qualifiedVehicles(int svc) const {
-   return m_qualifVehi[svc];
-}
-
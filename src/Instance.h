@@ -28,9 +28,17 @@
 
 #pragma once
 
+#include "AlignedAllocator.h"
+#include "Span.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <iosfwd>
+#include <memory>
+#include <string>
 #include <vector>
-#include <tuple>
 
 /*
  * Implentation of a instance to HHC problem.
@@ -49,38 +57,139 @@ public:
       SIM = 2
    };
 
-   Instance(const char *fname);
+   /**
+    * Pair of distinct vehicles that can attend a double service.
+    */
+   struct VehiclePair {
+      int v0;
+      int v1;
+   };
+
+   /// Skill sets are stored as bitmasks, which limits the number of skills.
+   constexpr static int MAX_SKILLS = 64;
+
+   /**
+    * Backends of the distance lookups, selected when loading the instance.
+    */
+   enum DistanceKind {
+      // Picks the dense matrix unless it exceeds `DIST_AUTO_DENSE_LIMIT`
+      // bytes, and then the most compact backend that suits the instance.
+      DIST_AUTO = 0,
+
+      // Full matrix, as read from the instance file.
+      DIST_DENSE,
+
+      // Packed upper triangle in single precision. Requires a matrix that is
+      // symmetric once rounded to single precision.
+      DIST_TRIANGULAR,
+
+      // Computed on the fly from the node coordinates. Requires all distances
+      // to match the euclidean distance within `DIST_EUCLIDEAN_TOL`.
+      DIST_EUCLIDEAN
+   };
+
+   constexpr static size_t DIST_AUTO_DENSE_LIMIT = size_t(256) << 20;
+   constexpr static double DIST_EUCLIDEAN_TOL = 1e-3;
+
+   /**
+    * Loads an instance from disk. The file can be either in the text format
+    * of Mankowska et al. (2014) or in the binary cache format produced by
+    * `writeBinary`; the format is detected by the leading magic bytes.
+    * Text files may also be compressed with xz or gzip.
+    *
+    * Throws `std::runtime_error` describing the file, line and section of
+    * any parsing error, or if the distance backend does not suit the instance.
+    */
+   Instance(const char *fname, DistanceKind distKind = DIST_AUTO);
    virtual ~Instance();
 
-   int numVehicles() const;
-   int numNodes() const;
-   int numSkills() const;
+   /**
+    * Writes the instance in the binary cache format. Such files are mapped
+    * read-only into memory when loaded, so concurrent runs over the same
+    * instance share a single page-cached copy of the distance matrix.
+    * Requires the dense backend, whose matrix is written exactly; throws
+    * `std::runtime_error` otherwise.
+    */
+   void writeBinary(const char *fname) const;
+
+   /**
+    * Returns true if the file starts with the magic bytes of the binary
+    * cache format.
+    */
+   static bool isBinaryFile(const char *fname);
+
+   // Accessors used within the decoder hot loop are defined inline below.
+   inline int numVehicles() const;
+   inline int numNodes() const;
+   inline int numSkills() const;
+
+   inline bool vehicleHasSkill(int vehicle, int skill) const;
+   inline bool nodeReqSkill(int node, int skill) const;
+
+   inline SvcType nodeSvcType(int node) const;
+
+   inline double nodeDeltaMin(int node) const;
+   inline double nodeDeltaMax(int node) const;
 
-   bool vehicleHasSkill(int vehicle, int skill) const;
-   bool nodeReqSkill(int node, int skill) const;
+   inline double nodeTwMin(int node) const;
+   inline double nodeTwMax(int node) const;
 
-   SvcType nodeSvcType(int node) const;
+   inline double nodeProcTime(int node, int skill) const;
 
-   double nodeDeltaMin(int node) const;
-   double nodeDeltaMax(int node) const;
+   inline double nodePosX(int node) const;
+   inline double nodePosY(int node) const;
 
-   double nodeTwMin(int node) const;
-   double nodeTwMax(int node) const;
+   inline double distance(int fromNode, int toNode) const;
 
-   double nodeProcTime(int node, int skill) const;
+   /// Backend used for the distance lookups, and the memory it requires.
+   DistanceKind distanceKind() const;
+   size_t distanceBytes() const;
 
-   double nodePosX(int node) const;
-   double nodePosY(int node) const;
+   static const char *distanceKindName(DistanceKind kind);
+   static DistanceKind distanceKindFromName(const std::string &name);
 
-   double distance(int fromNode, int toNode) const;
+   /**
+    * Number of elements of each per-node array, and of each row of the
+    * distance matrix. Both are padded to fill whole cache lines.
+    */
+   inline int nodeStride() const;
+   inline int distanceStride() const;
 
    const std::string &fileName() const;
 
    friend std::ostream &operator<<(std::ostream &out, const Instance &inst);
 
-   const std::vector <int> nodeSkills(int node) const;
-   const std::vector <int> vehiSkills(int vehi) const;
-   const std::vector <int> qualifiedVehicles(int svc) const;
+   /**
+    * Read-only views of the precompiled candidate-assignment index.
+    * The spans remain valid for the lifetime of the instance.
+    */
+   inline Span<int> nodeSkills(int node) const;
+   inline Span<int> vehiSkills(int vehi) const;
+   inline Span<int> qualifiedVehicles(int svc) const;
+
+   /**
+    * Qualified vehicles for the k-th skill (in ascending order of skill
+    * index) required by a node.
+    */
+   inline Span<int> nodeQualifiedVehicles(int node, int k) const;
+
+   /**
+    * Valid (v0, v1) assignments of a double service node, with v0 != v1,
+    * where v0 is qualified to the first skill and v1 to the second one. Pairs
+    * are sorted lexicographically by their position in the lists of qualified
+    * vehicles. Empty for single service nodes.
+    */
+   inline Span<VehiclePair> nodeVehiclePairs(int node) const;
+
+   inline uint64_t vehicleSkillMask(int vehicle) const;
+   inline uint64_t nodeSkillMask(int node) const;
+
+   /**
+    * For each patient, the `count` nearest patients that may precede it
+    * without violating its time window, ties broken by the node index. Lists
+    * are stored with a stride of `count`, padded with -1.
+    */
+   std::vector<int> nearestPredecessors(int count) const;
 
 protected:
    /**
@@ -89,24 +198,185 @@ protected:
    void resize();
    void resize(int numNodes, int numVehicles, int numSkills);
 
+   /**
+    * Parsers of the supported file formats.
+    */
+   void readText(const char *fname, DistanceKind distKind);
+   void readBinary(const char *fname);
+
+   /**
+    * Builds the skill-related caches once all instance data is in place.
+    */
+   void buildCaches();
+
+   /**
+    * Fills `rows` with the distances from the nodes [first, last), with
+    * `stride` elements per row. Rows are requested in increasing order, and
+    * again from the first one if the backend chosen has to be revised.
+    */
+   using DistanceRows = std::function<void(int first, int last, double *rows, int stride)>;
+
+   /**
+    * Chooses the distance backend requested and stores the matrix in it,
+    * reading a few rows at a time so that the dense matrix is only
+    * allocated if it is the backend chosen.
+    */
+   void selectDistanceProvider(DistanceKind kind, const DistanceRows &readRows);
+
 private:
    std::string m_fname;
    int m_numNodes;
    int m_numVehicles;
    int m_numSkills;
 
-   std::vector <std::vector<int>> m_vehicleSkills;
-   std::vector <std::vector<int>> m_nodeReqSkills;
-   std::vector <SvcType> m_nodeSvcType;
+   // Bit `s` set if the vehicle has (or the node requires) the skill `s`.
+   std::vector <uint64_t> m_vehicleSkills;
+   std::vector <uint64_t> m_nodeReqSkills;
+
+   // Per-node data is kept as a structure of arrays, each one padded
+   // to `m_nodeStride` elements.
+   int m_nodeStride;
+   AlignedVector <SvcType> m_nodeSvcType;
+
+   AlignedVector <double> m_nodeDeltaMin;
+   AlignedVector <double> m_nodeDeltaMax;
+   AlignedVector <double> m_nodeTwMin;
+   AlignedVector <double> m_nodeTwMax;
+   AlignedVector <double> m_nodePosX;
+   AlignedVector <double> m_nodePosY;
+
+   // Skill-major processing times: [skill*m_nodeStride + node].
+   AlignedVector <double> m_nodeProcTime;
+
+   // Row-major distance matrix, with `m_distStride` elements per row.
+   // The memory block is either owned by the instance (text format) or
+   // is a read-only mapping of a binary cache file. In both cases,
+   // `m_distBlock` keeps the block alive while any copy of the instance exists.
+   const double *m_distances;
+   int m_distStride;
+   std::shared_ptr <const void> m_distBlock;
 
-   std::vector <std::tuple<double, double>> m_nodeDelta;
-   std::vector <std::tuple<double, double>> m_nodeTw;
-   std::vector <std::vector<double>> m_nodeProcTime;
-   std::vector <std::tuple<double, double>> m_nodePos;
+   // Alternative backends of distance lookups. The triangular matrix stores
+   // the element (i,j), i <= j, at position `m_distTriRowOff[i] + j`.
+   DistanceKind m_distKind;
+   const float *m_distTri;
+   std::vector <int64_t> m_distTriRowOff;
 
-   std::vector <std::vector <double>> m_distances;
+   // Candidate-assignment index. Each list is stored contiguously in a
+   // flat array, and delimited by the offsets [off[k], off[k+1]).
+   std::vector <int> m_nodeSkills, m_nodeSkillsOff;
+   std::vector <int> m_vehiSkills, m_vehiSkillsOff;
+   std::vector <int> m_qualifVehi, m_qualifVehiOff;
 
-   std::vector<std::vector<int>> m_nodeSkills;
-   std::vector<std::vector<int>> m_vehiSkills;
-   std::vector<std::vector<int>> m_qualifVehi;
+   // Pairs are shared among nodes requiring the same skills.
+   // Node `i` uses the range [m_nodePairsOff[2*i], m_nodePairsOff[2*i+1]).
+   std::vector <VehiclePair> m_vehiPairs;
+   std::vector <int> m_nodePairsOff;
 };
+
+inline int Instance::numVehicles() const {
+   return m_numVehicles;
+}
+
+inline int Instance::numNodes() const {
+   return m_numNodes;
+}
+
+inline int Instance::numSkills() const {
+   return m_numSkills;
+}
+
+inline bool Instance::vehicleHasSkill(int vehicle, int skill) const {
+   return (m_vehicleSkills[vehicle] >> skill) & 1;
+}
+
+inline bool Instance::nodeReqSkill(int node, int skill) const {
+   return (m_nodeReqSkills[node] >> skill) & 1;
+}
+
+inline Instance::SvcType Instance::nodeSvcType(int node) const {
+   return m_nodeSvcType[node];
+}
+
+inline double Instance::nodeDeltaMin(int node) const {
+   return m_nodeDeltaMin[node];
+}
+
+inline double Instance::nodeDeltaMax(int node) const {
+   return m_nodeDeltaMax[node];
+}
+
+inline double Instance::nodeTwMin(int node) const {
+   return m_nodeTwMin[node];
+}
+
+inline double Instance::nodeTwMax(int node) const {
+   return m_nodeTwMax[node];
+}
+
+inline double Instance::nodeProcTime(int node, int skill) const {
+   return m_nodeProcTime[skill*m_nodeStride + node];
+}
+
+inline double Instance::nodePosX(int node) const {
+   return m_nodePosX[node];
+}
+
+inline double Instance::nodePosY(int node) const {
+   return m_nodePosY[node];
+}
+
+inline double Instance::distance(int fromNode, int toNode) const {
+   switch (m_distKind) {
+      case DIST_TRIANGULAR: {
+         const int i = std::min(fromNode, toNode);
+         const int j = std::max(fromNode, toNode);
+         return m_distTri[m_distTriRowOff[i] + j];
+      }
+
+      case DIST_EUCLIDEAN: {
+         const double dx = m_nodePosX[fromNode] - m_nodePosX[toNode];
+         const double dy = m_nodePosY[fromNode] - m_nodePosY[toNode];
+         return std::sqrt(dx*dx + dy*dy);
+      }
+
+      default:
+         return m_distances[size_t(fromNode)*m_distStride + toNode];
+   }
+}
+
+inline int Instance::nodeStride() const {
+   return m_nodeStride;
+}
+
+inline int Instance::distanceStride() const {
+   return m_distStride;
+}
+
+inline Span<int> Instance::nodeSkills(int node) const {
+   return Span<int>(m_nodeSkills.data() + m_nodeSkillsOff[node], m_nodeSkills.data() + m_nodeSkillsOff[node+1]);
+}
+
+inline Span<int> Instance::vehiSkills(int vehi) const {
+   return Span<int>(m_vehiSkills.data() + m_vehiSkillsOff[vehi], m_vehiSkills.data() + m_vehiSkillsOff[vehi+1]);
+}
+
+inline Span<int> Instance::qualifiedVehicles(int svc) const {
+   return Span<int>(m_qualifVehi.data() + m_qualifVehiOff[svc], m_qualifVehi.data() + m_qualifVehiOff[svc+1]);
+}
+
+inline Span<int> Instance::nodeQualifiedVehicles(int node, int k) const {
+   return qualifiedVehicles(m_nodeSkills[m_nodeSkillsOff[node] + k]);
+}
+
+inline Span<Instance::VehiclePair> Instance::nodeVehiclePairs(int node) const {
+   return Span<VehiclePair>(m_vehiPairs.data() + m_nodePairsOff[2*node], m_vehiPairs.data() + m_nodePairsOff[2*node+1]);
+}
+
+inline uint64_t Instance::vehicleSkillMask(int vehicle) const {
+   return m_vehicleSkills[vehicle];
+}
+
+inline uint64_t Instance::nodeSkillMask(int node) const {
+   return m_nodeReqSkills[node];
+}
@@ -0,0 +1,162 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "KeySorter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+
+/// Maps a double to an unsigned integer with the same ordering. Negative zero
+/// is mapped as positive zero, since both compare equal.
+inline uint64_t orderedBits(double key) {
+   key += 0.0;
+   uint64_t bits;
+   memcpy(&bits, &key, sizeof(bits));
+   const uint64_t sign = uint64_t(1) << 63;
+   return (bits & sign) ? ~bits : (bits | sign);
+}
+
+}
+
+const std::vector<int> &KeySorter::sort(const double *keys, int n, bool fast) {
+   PROFILE_ZONE("sort");
+   if (!fast) {
+      m_order.resize(n);
+      iota(m_order.begin(), m_order.end(), 0);
+      std::sort(m_order.begin(), m_order.end(), [&](int i, int j) {
+         return keys[i] < keys[j] || (keys[i] == keys[j] && i < j);
+      });
+      m_prevKeys.clear();
+      ++fullSorts;
+      return m_order;
+   }
+
+   if (incrementalSort(keys, n)) {
+      ++incrementalSorts;
+   } else {
+      radixSort(keys, n);
+      ++fullSorts;
+   }
+   m_prevKeys.assign(keys, keys + n);
+   return m_order;
+}
+
+void KeySorter::reserve(int n) {
+   m_order.reserve(n);
+   m_tmpOrder.reserve(n);
+   m_changed.reserve(n);
+   m_bits.reserve(n);
+   m_tmpBits.reserve(n);
+   m_isChanged.reserve(n);
+   m_prevKeys.reserve(n);
+}
+
+void KeySorter::radixSort(const double *keys, int n) {
+   constexpr int DIGITS = 8;
+   constexpr int RADIX = 256;
+
+   m_bits.resize(n);
+   m_tmpBits.resize(n);
+   m_order.resize(n);
+   m_tmpOrder.resize(n);
+
+   // Histograms of all digits are built in a single pass.
+   uint32_t hist[DIGITS][RADIX] = {};
+   for (int i = 0; i < n; ++i) {
+      const uint64_t bits = orderedBits(keys[i]);
+      m_bits[i] = bits;
+      m_order[i] = i;
+      for (int d = 0; d < DIGITS; ++d)
+         ++hist[d][(bits >> (8*d)) & (RADIX-1)];
+   }
+
+   // Stable scatter by each digit, from the least significant one. Digits
+   // shared by all keys (e.g., most of the exponent) are skipped.
+   for (int d = 0; d < DIGITS; ++d) {
+      const int shift = 8*d;
+      if (n == 0 || hist[d][(m_bits[0] >> shift) & (RADIX-1)] == static_cast<uint32_t>(n))
+         continue;
+
+      uint32_t offset = 0;
+      for (int r = 0; r < RADIX; ++r) {
+         const uint32_t count = hist[d][r];
+         hist[d][r] = offset;
+         offset += count;
+      }
+
+      for (int i = 0; i < n; ++i) {
+         const uint32_t pos = hist[d][(m_bits[i] >> shift) & (RADIX-1)]++;
+         m_tmpBits[pos] = m_bits[i];
+         m_tmpOrder[pos] = m_order[i];
+      }
+      m_bits.swap(m_tmpBits);
+      m_order.swap(m_tmpOrder);
+   }
+}
+
+bool KeySorter::incrementalSort(const double *keys, int n) {
+   if (static_cast<int>(m_prevKeys.size()) != n)
+      return false;
+
+   // Repairing pays off only if a small fraction of the keys changed.
+   const int limit = n/8;
+   m_changed.clear();
+   for (int i = 0; i < n; ++i) {
+      if (keys[i] != m_prevKeys[i]) {
+         if (static_cast<int>(m_changed.size()) >= limit)
+            return false;
+         m_changed.push_back(i);
+      }
+   }
+
+   auto less = [&](int i, int j) {
+      return keys[i] < keys[j] || (keys[i] == keys[j] && i < j);
+   };
+
+   // Unchanged indices keep their relative order.
+   m_isChanged.assign(n, 0);
+   for (int i: m_changed)
+      m_isChanged[i] = 1;
+   m_tmpOrder.clear();
+   for (int i: m_order) {
+      if (!m_isChanged[i])
+         m_tmpOrder.push_back(i);
+   }
+
+   std::sort(m_changed.begin(), m_changed.end(), less);
+   m_order.resize(n);
+   merge(m_tmpOrder.begin(), m_tmpOrder.end(), m_changed.begin(), m_changed.end(), m_order.begin(), less);
+   return true;
+}
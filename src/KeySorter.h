@@ -0,0 +1,71 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Sorts the indices of random keys by ascending key value, breaking ties by
+ * the index, i.e., the same order of `std::sort` with that comparator.
+ *
+ * Keys are mapped to order-preserving 64-bit integers and sorted by an LSD
+ * radix sort. When the keys differ from those of the previous call in a few
+ * positions only, as in path relinking or with low mutation rates, the
+ * previous order is repaired instead: changed indices are removed, sorted
+ * apart and merged back. All buffers are reused between calls.
+ */
+class KeySorter {
+public:
+   /**
+    * Returns the sorted indices of keys[0..n). If `fast` is false, uses
+    * `std::sort` instead of the radix or incremental sorts.
+    * The reference remains valid until the next call.
+    */
+   const std::vector <int> &sort(const double *keys, int n, bool fast = true);
+
+   /// Allocates the buffers for sorting n keys.
+   void reserve(int n);
+
+   // Number of sorts done from scratch and by repairing the previous order.
+   uint64_t fullSorts {0};
+   uint64_t incrementalSorts {0};
+
+private:
+   void radixSort(const double *keys, int n);
+   bool incrementalSort(const double *keys, int n);
+
+   std::vector <int> m_order, m_tmpOrder, m_changed;
+   std::vector <uint64_t> m_bits, m_tmpBits;
+   std::vector <char> m_isChanged;
+
+   // Keys of the previous call, to which `m_order` corresponds.
+   std::vector <double> m_prevKeys;
+};
@@ -0,0 +1,844 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "LocalSearch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+using namespace std;
+
+namespace {
+   // Moves must improve the cost by at least this much, so that rounding
+   // errors do not make the search cycle.
+   constexpr double MIN_IMPROVEMENT = 1e-6;
+}
+
+LocalSearch::LocalSearch(const Instance &inst, int granularity): m_inst(inst) {
+   m_routes.resize(inst.numVehicles());
+   m_tailMask.resize(inst.numVehicles());
+
+   m_granularity = min(max(granularity, 0), inst.numNodes() - 3);
+   if (m_granularity > 0)
+      m_neighbours = inst.nearestPredecessors(m_granularity);
+   else
+      m_granularity = 0;
+}
+
+bool LocalSearch::isNeighbour(int node, int pred) const {
+   if (m_granularity == 0 || pred == 0)
+      return true;
+   if (node == 0)
+      return false;
+   const int *list = &m_neighbours[static_cast<size_t>(node) * m_granularity];
+   for (int k = 0; k < m_granularity && list[k] >= 0; ++k)
+      if (list[k] == pred)
+         return true;
+   return false;
+}
+
+bool LocalSearch::improve(Solution &sol, int maxPasses) {
+   load(sol);
+   if (!schedule()) {
+      assert(false && "Solution with circular synchronisations.");
+      return false;
+   }
+
+   const double initial = cost();
+   for (int pass = 0; pass < maxPasses && !expired(); ++pass) {
+      bool improved = false;
+      for (int id = 0; id < (int) m_visits.size() && !expired(); ++id)
+         improved |= relocate(id);
+      for (int id = 0; id < (int) m_visits.size() && !expired(); ++id)
+         improved |= swapVisit(id);
+      for (int a = 0; a < (int) m_routes.size() && !expired(); ++a) {
+         for (int b = a+1; b < (int) m_routes.size(); ++b)
+            improved |= twoOptStar(a, b);
+      }
+      if (!improved)
+         break;
+   }
+
+   if (cost() > initial - MIN_IMPROVEMENT)
+      return false;
+   store(sol);
+   return true;
+}
+
+void LocalSearch::load(const Solution &sol) {
+   m_visits.clear();
+   for (auto &route: m_routes)
+      route.clear();
+
+   // Routes hold the visits in the order they were inserted.
+   for (const Task &task: sol.insertOrder) {
+      const int id = m_visits.size();
+      const int count = task.skills[1] != -1 ? 2 : 1;
+      for (int k = 0; k < count; ++k) {
+         Visit x;
+         x.node = task.node;
+         x.skill = task.skills[k];
+         x.route = task.vehi[k];
+         x.pos = m_routes[x.route].size();
+         x.partner = count == 2 ? id + 1-k : -1;
+         x.first = k == 0;
+         x.start = x.leave = x.tard = x.reach = 0.0;
+         m_routes[x.route].push_back(id + k);
+         m_visits.push_back(x);
+      }
+   }
+
+   m_queued.assign(m_visits.size(), 0);
+   m_isSaved.assign(m_visits.size(), 0);
+   m_color.assign(m_visits.size(), 0);
+   m_rank.resize(m_visits.size());
+}
+
+void LocalSearch::store(Solution &sol) const {
+   // Replays the visits in the order they were scheduled, so that the
+   // insertion order and the costs are those a decoding would build.
+   sol.reset();
+   for (size_t k = 0; k < m_order.size(); ++k) {
+      const Visit &x = m_visits[m_order[k]];
+      const Visit *visits[2] = {&x, nullptr};
+      if (x.partner != -1) {
+         const Visit &y = m_visits[m_order[++k]];
+         visits[0] = x.first ? &x : &y;
+         visits[1] = x.first ? &y : &x;
+      }
+
+      Task task(x.node, visits[0]->skill, visits[1] ? visits[1]->skill : -1);
+      task.incDist = 0.0;
+      task.incTard = 0.0;
+      task.currTmax = 0.0;
+      task.leaveTime[1] = 0.0;
+      task.vehi[1] = -1;
+      for (int r = 0; r < 2 && visits[r]; ++r) {
+         const int pos = sol.vehiPos[visits[r]->route];
+         task.vehi[r] = visits[r]->route;
+         task.leaveTime[r] = visits[r]->leave;
+         task.incDist += m_inst.distance(pos, x.node);
+         if (sol.convHull)
+            task.incDist += m_inst.distance(x.node, 0) - m_inst.distance(pos, 0);
+         task.incTard += visits[r]->tard;
+         task.currTmax = max(task.currTmax, visits[r]->tard);
+      }
+      task.cachedCost =
+         DecodeState::COEFS[0] * (sol.dist + task.incDist) +
+         DecodeState::COEFS[1] * (sol.tard + task.incTard) +
+         DecodeState::COEFS[2] * max(sol.tmax, task.currTmax);
+      sol.updateRoutes(task);
+   }
+   sol.finishRoutes();
+}
+
+double LocalSearch::cost() const {
+   return
+      DecodeState::COEFS[0] * m_dist +
+      DecodeState::COEFS[1] * m_tard +
+      DecodeState::COEFS[2] * m_tmax;
+}
+
+double LocalSearch::arrival(const Visit &x) const {
+   int prevNode = 0;
+   double prevLeave = 0.0;
+   if (x.pos > 0) {
+      const Visit &prev = m_visits[m_routes[x.route][x.pos-1]];
+      prevNode = prev.node;
+      prevLeave = prev.leave;
+   }
+   return max(m_inst.nodeTwMin(x.node), prevLeave + m_inst.distance(prevNode, x.node));
+}
+
+void LocalSearch::syncStarts(const Visit &x, const Visit &y, double &startX, double &startY) const {
+   syncStarts(x, arrival(x), arrival(y), startX, startY);
+}
+
+void LocalSearch::syncStarts(const Visit &x, double arrivalX, double arrivalY, double &startX, double &startY) const {
+   if (m_inst.nodeSvcType(x.node) == Instance::SvcType::SIM) {
+      startX = startY = max(arrivalX, arrivalY);
+      return;
+   }
+
+   // Same rule as the decoder: the second service waits for the minimum
+   // separation, and the first one is delayed to meet the maximum separation.
+   double start0 = x.first ? arrivalX : arrivalY;
+   double start1 = max(x.first ? arrivalY : arrivalX, start0 + m_inst.nodeDeltaMin(x.node));
+   start0 += max(0.0, (start1 - start0) - m_inst.nodeDeltaMax(x.node));
+   startX = x.first ? start0 : start1;
+   startY = x.first ? start1 : start0;
+}
+
+double LocalSearch::reachAt(int route, int pos) const {
+   return pos < (int) m_routes[route].size() ? m_visits[m_routes[route][pos]].reach : 0.0;
+}
+
+bool LocalSearch::schedule() {
+   const int numRoutes = m_routes.size();
+   m_next.assign(numRoutes, 0);
+   m_ready.clear();
+   for (int r = numRoutes-1; r >= 0; --r)
+      m_ready.push_back(r);
+   m_order.clear();
+
+   // Each route is scheduled up to a double service whose other visit is
+   // not the next one of its route yet. That route resumes this one when it
+   // gets there.
+   while (!m_ready.empty()) {
+      const int r = m_ready.back();
+      m_ready.pop_back();
+      while (m_next[r] < (int) m_routes[r].size()) {
+         const int id = m_routes[r][m_next[r]];
+         Visit &x = m_visits[id];
+         if (x.partner == -1) {
+            x.start = arrival(x);
+            x.leave = x.start + m_inst.nodeProcTime(x.node, x.skill);
+            m_order.push_back(id);
+         } else {
+            Visit &y = m_visits[x.partner];
+            if (m_next[y.route] != y.pos)
+               break;
+            syncStarts(x, y, x.start, y.start);
+            x.leave = x.start + m_inst.nodeProcTime(x.node, x.skill);
+            y.leave = y.start + m_inst.nodeProcTime(y.node, y.skill);
+            m_order.push_back(id);
+            m_order.push_back(x.partner);
+            ++m_next[y.route];
+            m_ready.push_back(y.route);
+         }
+         ++m_next[r];
+      }
+   }
+   if (m_order.size() != m_visits.size())
+      return false;
+   for (size_t k = 0; k < m_order.size(); ++k) {
+      const Visit &x = m_visits[m_order[k]];
+      m_rank[m_order[k]] = x.partner != -1 && !x.first ? m_rank[x.partner] : k;
+   }
+
+   m_dist = 0.0;
+   for (int r = 0; r < numRoutes; ++r) {
+      const auto &route = m_routes[r];
+      int prev = 0;
+      for (int id: route) {
+         m_dist += m_inst.distance(prev, m_visits[id].node);
+         prev = m_visits[id].node;
+      }
+      m_dist += m_inst.distance(prev, 0);
+
+      auto &mask = m_tailMask[r];
+      mask.resize(route.size()+1);
+      mask[route.size()] = 0;
+      for (int pos = route.size()-1; pos >= 0; --pos)
+         mask[pos] = mask[pos+1] | (uint64_t(1) << m_visits[route[pos]].skill);
+   }
+
+   m_tard = 0.0;
+   m_tmax = 0.0;
+   m_tmaxCount = 0;
+   for (Visit &x: m_visits) {
+      x.tard = max(0.0, x.start - m_inst.nodeTwMax(x.node));
+      m_tard += x.tard;
+      if (x.tard > m_tmax) {
+         m_tmax = x.tard;
+         m_tmaxCount = 1;
+      } else if (x.tard == m_tmax) {
+         ++m_tmaxCount;
+      }
+   }
+
+   // The visits scheduled after a visit come later in the order.
+   for (auto it = m_order.rbegin(); it != m_order.rend(); ++it) {
+      Visit &x = m_visits[*it];
+      double reach = x.tard + reachAt(x.route, x.pos+1);
+      if (x.partner != -1) {
+         const Visit &y = m_visits[x.partner];
+         reach += y.tard + reachAt(y.route, y.pos+1);
+      }
+      x.reach = min(reach, m_tard);
+   }
+
+   return true;
+}
+
+bool LocalSearch::relocate(int id) {
+   const Visit &x = m_visits[id];
+   const int a = x.route;
+   const int i = x.pos;
+   const auto &ra = m_routes[a];
+
+   const int prev = i > 0 ? m_visits[ra[i-1]].node : 0;
+   const int next = i+1 < (int) ra.size() ? m_visits[ra[i+1]].node : 0;
+   const double removal =
+      m_inst.distance(prev, next) - m_inst.distance(prev, x.node) - m_inst.distance(x.node, next);
+
+   // Moving a visit of a double service to another route re-assigns it.
+   for (int b: m_inst.qualifiedVehicles(x.skill)) {
+      if (x.partner != -1 && m_visits[x.partner].route == b)
+         continue;
+
+      // Visits of the route once `x` is removed from it.
+      const auto &rb = m_routes[b];
+      const int len = rb.size() - (a == b);
+      auto at = [&] (int k) {
+         return &m_visits[a == b && k >= i ? rb[k+1] : rb[k]];
+      };
+
+      for (int j = 0; j <= len; ++j) {
+         if (a == b && j == i)
+            continue;
+         const int u = j > 0 ? at(j-1)->node : 0;
+         const int w = j < len ? at(j)->node : 0;
+         if (!isNeighbour(x.node, u) && !isNeighbour(w, x.node))
+            continue;
+         const double delta = removal +
+            m_inst.distance(u, x.node) + m_inst.distance(x.node, w) - m_inst.distance(u, w);
+         const Move mv {RELOCATE, a, i, b, j};
+         if (promising(delta, x.reach + (j < len ? at(j)->reach : 0.0)) && improves(mv, delta) &&
+               attempt(mv, delta))
+            return true;
+      }
+   }
+   return false;
+}
+
+bool LocalSearch::swapVisit(int id) {
+   bool improved = false;
+   const Visit &x = m_visits[id];
+   for (int other = id+1; other < (int) m_visits.size(); ++other) {
+      const Visit &y = m_visits[other];
+      if (x.route != y.route) {
+         if (!m_inst.vehicleHasSkill(x.route, y.skill) || !m_inst.vehicleHasSkill(y.route, x.skill))
+            continue;
+         if (x.partner != -1 && x.partner != other && m_visits[x.partner].route == y.route)
+            continue;
+         if (y.partner != -1 && y.partner != id && m_visits[y.partner].route == x.route)
+            continue;
+      }
+
+      auto prevNode = [&] (const Visit &v) {
+         return v.pos > 0 ? m_visits[m_routes[v.route][v.pos-1]].node : 0;
+      };
+      auto nextNode = [&] (const Visit &v) {
+         return v.pos+1 < (int) m_routes[v.route].size() ? m_visits[m_routes[v.route][v.pos+1]].node : 0;
+      };
+
+      double delta;
+      if (x.route == y.route && abs(x.pos - y.pos) == 1) {
+         const Visit &p = x.pos < y.pos ? x : y;
+         const Visit &q = x.pos < y.pos ? y : x;
+         const int before = prevNode(p), after = nextNode(q);
+         if (!isNeighbour(q.node, before) && !isNeighbour(p.node, q.node) && !isNeighbour(after, p.node))
+            continue;
+         delta =
+            m_inst.distance(before, q.node) + m_inst.distance(q.node, p.node) + m_inst.distance(p.node, after) -
+            m_inst.distance(before, p.node) - m_inst.distance(p.node, q.node) - m_inst.distance(q.node, after);
+      } else {
+         const int px = prevNode(x), nx = nextNode(x);
+         const int py = prevNode(y), ny = nextNode(y);
+         if (!isNeighbour(y.node, px) && !isNeighbour(nx, y.node) &&
+               !isNeighbour(x.node, py) && !isNeighbour(ny, x.node))
+            continue;
+         delta =
+            m_inst.distance(px, y.node) + m_inst.distance(y.node, nx) -
+            m_inst.distance(px, x.node) - m_inst.distance(x.node, nx) +
+            m_inst.distance(py, x.node) + m_inst.distance(x.node, ny) -
+            m_inst.distance(py, y.node) - m_inst.distance(y.node, ny);
+      }
+
+      const Move mv {SWAP, x.route, x.pos, y.route, y.pos};
+      if (promising(delta, x.reach + y.reach) && improves(mv, delta) && attempt(mv, delta))
+         improved = true;
+   }
+   return improved;
+}
+
+bool LocalSearch::twoOptStar(int a, int b) {
+   const auto &ra = m_routes[a];
+   const auto &rb = m_routes[b];
+   const int lenA = ra.size();
+   const int lenB = rb.size();
+   const uint64_t maskA = m_inst.vehicleSkillMask(a);
+   const uint64_t maskB = m_inst.vehicleSkillMask(b);
+
+   for (int i = 0; i <= lenA; ++i) {
+      if (m_tailMask[a][i] & ~maskB)
+         continue;
+      const int endA = i > 0 ? m_visits[ra[i-1]].node : 0;
+      const int startA = i < lenA ? m_visits[ra[i]].node : 0;
+
+      for (int j = 0; j <= lenB; ++j) {
+         // Exchanging nothing, or whole routes, changes no route.
+         if ((i == 0 && j == 0) || (i == lenA && j == lenB))
+            continue;
+         if (m_tailMask[b][j] & ~maskA)
+            continue;
+         const int endB = j > 0 ? m_visits[rb[j-1]].node : 0;
+         const int startB = j < lenB ? m_visits[rb[j]].node : 0;
+         if (!isNeighbour(startB, endA) && !isNeighbour(startA, endB))
+            continue;
+         const double delta =
+            m_inst.distance(endA, startB) + m_inst.distance(endB, startA) -
+            m_inst.distance(endA, startA) - m_inst.distance(endB, startB);
+         if (!promising(delta, reachAt(a, i) + reachAt(b, j)))
+            continue;
+
+         // Both visits of a double service cannot end up in the same route.
+         bool valid = true;
+         for (int k = i; k < lenA && valid; ++k) {
+            const int partner = m_visits[ra[k]].partner;
+            valid = partner == -1 || m_visits[partner].route != b || m_visits[partner].pos >= j;
+         }
+         for (int k = j; k < lenB && valid; ++k) {
+            const int partner = m_visits[rb[k]].partner;
+            valid = partner == -1 || m_visits[partner].route != a || m_visits[partner].pos >= i;
+         }
+         const Move mv {TWO_OPT_STAR, a, i, b, j};
+         if (valid && improves(mv, delta) && attempt(mv, delta))
+            return true;
+      }
+   }
+   return false;
+}
+
+bool LocalSearch::promising(double deltaDist, double reducible) {
+   ++stats.movesConsidered;
+
+   // The largest tardiness decreases at most by the tardiness removed.
+   reducible = min(reducible, m_tard);
+   const double bound =
+      DecodeState::COEFS[0] * deltaDist -
+      DecodeState::COEFS[1] * reducible -
+      DecodeState::COEFS[2] * min(reducible, m_tmax);
+   if (bound > -MIN_IMPROVEMENT) {
+      ++stats.movesBounded;
+      return false;
+   }
+   return true;
+}
+
+bool LocalSearch::improves(const Move &mv, double deltaDist) {
+   Evaluation ev;
+   ev.enter(mv.a);
+   ev.enter(mv.b);
+
+   // Node and leave time of the visit before a position of a route.
+   auto before = [&] (int route, int pos, int &node, double &leave) {
+      node = 0;
+      leave = 0.0;
+      if (pos > 0) {
+         const Visit &prev = m_visits[m_routes[route][pos-1]];
+         node = prev.node;
+         leave = prev.leave;
+      }
+   };
+
+   // Visits `x` after `node`, which is then `x`.
+   auto step = [&] (const Visit &x, int &node, double &leave) {
+      bool unchanged;
+      if (!visit(x, node, leave, ev, leave, unchanged))
+         return false;
+      node = x.node;
+      return true;
+   };
+
+   // Visits the positions [from, to) of a route after `node`.
+   auto walk = [&] (int route, int from, int to, int &node, double &leave) {
+      for (int k = from; k < to; ++k)
+         if (!step(m_visits[m_routes[route][k]], node, leave))
+            return false;
+      return true;
+   };
+
+   int node;
+   double leave;
+   bool exact;
+   switch (mv.kind) {
+      case RELOCATE: {
+         const Visit &x = m_visits[m_routes[mv.a][mv.i]];
+         if (mv.a != mv.b) {
+            before(mv.a, mv.i, node, leave);
+            exact = follow(node, leave, mv.a, mv.i+1, ev);
+            before(mv.b, mv.j, node, leave);
+            exact = exact && step(x, node, leave) && follow(node, leave, mv.b, mv.j, ev);
+         } else if (mv.j < mv.i) {
+            before(mv.a, mv.j, node, leave);
+            exact = step(x, node, leave) && walk(mv.a, mv.j, mv.i, node, leave) &&
+               follow(node, leave, mv.a, mv.i+1, ev);
+         } else {
+            // Position j after removal is position j+1 before it.
+            before(mv.a, mv.i, node, leave);
+            exact = walk(mv.a, mv.i+1, mv.j+1, node, leave) && step(x, node, leave) &&
+               follow(node, leave, mv.a, mv.j+1, ev);
+         }
+         break;
+      }
+
+      case SWAP: {
+         const Visit &x = m_visits[m_routes[mv.a][mv.i]];
+         const Visit &y = m_visits[m_routes[mv.b][mv.j]];
+         if (mv.a != mv.b) {
+            before(mv.a, mv.i, node, leave);
+            exact = step(y, node, leave) && follow(node, leave, mv.a, mv.i+1, ev);
+            before(mv.b, mv.j, node, leave);
+            exact = exact && step(x, node, leave) && follow(node, leave, mv.b, mv.j+1, ev);
+         } else {
+            const int p = min(mv.i, mv.j), q = max(mv.i, mv.j);
+            before(mv.a, p, node, leave);
+            exact = step(m_visits[m_routes[mv.a][q]], node, leave) && walk(mv.a, p+1, q, node, leave) &&
+               step(m_visits[m_routes[mv.a][p]], node, leave) && follow(node, leave, mv.a, q+1, ev);
+         }
+         break;
+      }
+
+      default:
+         before(mv.a, mv.i, node, leave);
+         exact = follow(node, leave, mv.b, mv.j, ev);
+         before(mv.b, mv.j, node, leave);
+         exact = exact && follow(node, leave, mv.a, mv.i, ev);
+         break;
+   }
+
+   // The largest tardiness is unknown if all visits that held it are lowered.
+   if (!exact || (m_tmax > 0.0 && ev.lost == m_tmaxCount))
+      return true;
+
+   ++stats.movesEvaluated;
+   const double change =
+      DecodeState::COEFS[0] * deltaDist +
+      DecodeState::COEFS[1] * ev.tard +
+      DecodeState::COEFS[2] * (max(m_tmax, ev.tmax) - m_tmax);
+   return change < -MIN_IMPROVEMENT;
+}
+
+bool LocalSearch::visit(const Visit &x, int prevNode, double prevLeave, Evaluation &ev, double &leave,
+      bool &unchanged) {
+   ++stats.visitsFollowed;
+   double start = max(m_inst.nodeTwMin(x.node), prevLeave + m_inst.distance(prevNode, x.node));
+   if (x.partner != -1) {
+      const Visit &y = m_visits[x.partner];
+      if (ev.changes(y.route))
+         return false;
+
+      double startY;
+      syncStarts(x, start, arrival(y), start, startY);
+      if (startY != y.start) {
+         ev.record(y.tard, max(0.0, startY - m_inst.nodeTwMax(y.node)), m_tmax);
+         if (!ev.enter(y.route) ||
+               !follow(y.node, startY + m_inst.nodeProcTime(y.node, y.skill), y.route, y.pos+1, ev))
+            return false;
+      }
+   }
+
+   unchanged = start == x.start;
+   ev.record(x.tard, max(0.0, start - m_inst.nodeTwMax(x.node)), m_tmax);
+   leave = start + m_inst.nodeProcTime(x.node, x.skill);
+   return true;
+}
+
+bool LocalSearch::follow(int prevNode, double prevLeave, int route, int pos, Evaluation &ev) {
+   const auto &r = m_routes[route];
+   for (; pos < (int) r.size(); ++pos) {
+      const Visit &x = m_visits[r[pos]];
+      bool unchanged;
+      if (!visit(x, prevNode, prevLeave, ev, prevLeave, unchanged))
+         return false;
+      if (unchanged)
+         return true;
+      prevNode = x.node;
+   }
+   return true;
+}
+
+bool LocalSearch::attempt(const Move &mv, double deltaDist) {
+   ++stats.movesRetimed;
+   const double current = cost();
+
+   apply(mv);
+   seed(mv);
+   m_deltaTard = 0.0;
+
+   bool taken = false, scheduled = false;
+   const bool settled = acyclic() && retime();
+   if (settled) {
+      // The largest tardiness is among the visits re-timed, unless all
+      // visits that held it were re-timed to a lower value.
+      double tmax = m_tmax;
+      int lost = 0;
+      for (const Saved &s: m_saved) {
+         const double tard = m_visits[s.id].tard;
+         tmax = max(tmax, tard);
+         lost += m_tmax > 0.0 && s.tard == m_tmax && tard < m_tmax;
+      }
+      if (lost == m_tmaxCount) {
+         tmax = 0.0;
+         for (const Visit &x: m_visits)
+            tmax = max(tmax, x.tard);
+      }
+
+      const double updated =
+         DecodeState::COEFS[0] * (m_dist + deltaDist) +
+         DecodeState::COEFS[1] * (m_tard + m_deltaTard) +
+         DecodeState::COEFS[2] * tmax;
+      if (updated < current - MIN_IMPROVEMENT) {
+         // Also checks the synchronisations for cycles the re-timing may
+         // have settled on.
+         scheduled = true;
+         taken = schedule();
+      }
+   }
+   if (!settled || (scheduled && !taken))
+      ++stats.movesCyclic;
+
+   if (!taken) {
+      for (const Saved &s: m_saved) {
+         Visit &x = m_visits[s.id];
+         x.start = s.start;
+         x.leave = s.leave;
+         x.tard = s.tard;
+      }
+      if (mv.kind == RELOCATE)
+         apply({RELOCATE, mv.b, mv.j, mv.a, mv.i});
+      else
+         apply(mv);
+      if (scheduled)
+         schedule();
+   } else if (mv.kind == RELOCATE) {
+      const Visit &x = m_visits[m_routes[mv.b][mv.j]];
+      if (mv.a != mv.b && x.partner != -1)
+         ++stats.reassignments;
+      else
+         ++stats.relocations;
+   } else if (mv.kind == SWAP) {
+      ++stats.swaps;
+   } else {
+      ++stats.twoOptStars;
+   }
+
+   for (const Saved &s: m_saved)
+      m_isSaved[s.id] = 0;
+   m_saved.clear();
+   return taken;
+}
+
+void LocalSearch::apply(const Move &mv) {
+   auto &ra = m_routes[mv.a];
+   auto &rb = m_routes[mv.b];
+   switch (mv.kind) {
+      case RELOCATE: {
+         const int id = ra[mv.i];
+         ra.erase(ra.begin() + mv.i);
+         rb.insert(rb.begin() + mv.j, id);
+         if (mv.a == mv.b) {
+            renumber(mv.a, min(mv.i, mv.j));
+         } else {
+            renumber(mv.a, mv.i);
+            renumber(mv.b, mv.j);
+         }
+         break;
+      }
+
+      case SWAP:
+         swap(ra[mv.i], rb[mv.j]);
+         m_visits[ra[mv.i]].route = mv.a;
+         m_visits[ra[mv.i]].pos = mv.i;
+         m_visits[rb[mv.j]].route = mv.b;
+         m_visits[rb[mv.j]].pos = mv.j;
+         break;
+
+      case TWO_OPT_STAR:
+         m_tail.assign(ra.begin() + mv.i, ra.end());
+         ra.erase(ra.begin() + mv.i, ra.end());
+         ra.insert(ra.end(), rb.begin() + mv.j, rb.end());
+         rb.erase(rb.begin() + mv.j, rb.end());
+         rb.insert(rb.end(), m_tail.begin(), m_tail.end());
+         renumber(mv.a, mv.i);
+         renumber(mv.b, mv.j);
+         break;
+   }
+}
+
+void LocalSearch::renumber(int route, int from) {
+   const auto &r = m_routes[route];
+   for (int pos = from; pos < (int) r.size(); ++pos) {
+      m_visits[r[pos]].route = route;
+      m_visits[r[pos]].pos = pos;
+   }
+}
+
+void LocalSearch::seed(const Move &mv) {
+   auto enqueueAt = [&] (int route, int pos) {
+      if (pos < (int) m_routes[route].size())
+         enqueue(m_routes[route][pos]);
+   };
+
+   switch (mv.kind) {
+      case RELOCATE:
+         // The visit moved, the one after it, and the one that followed it.
+         enqueueAt(mv.b, mv.j);
+         enqueueAt(mv.b, mv.j+1);
+         enqueueAt(mv.a, mv.a == mv.b && mv.j < mv.i ? mv.i+1 : mv.i);
+         break;
+
+      case SWAP:
+         enqueueAt(mv.a, mv.i);
+         enqueueAt(mv.a, mv.i+1);
+         enqueueAt(mv.b, mv.j);
+         enqueueAt(mv.b, mv.j+1);
+         break;
+
+      case TWO_OPT_STAR:
+         enqueueAt(mv.a, mv.i);
+         enqueueAt(mv.b, mv.j);
+         break;
+   }
+}
+
+bool LocalSearch::acyclic() {
+   // Ranks increase along the arcs of the schedule before the move, so any
+   // cycle takes one of the new arcs that go to a lower rank, and never
+   // leaves the visits ranked up to the highest origin of those arcs.
+   int maxTail = -1;
+   for (int id: m_queue) {
+      const Visit &x = m_visits[id];
+      if (x.pos > 0) {
+         const int tail = m_rank[m_routes[x.route][x.pos-1]];
+         if (tail >= m_rank[id])
+            maxTail = max(maxTail, tail);
+      }
+   }
+   if (maxTail == -1)
+      return true;
+
+   // Depth-first search, taking both visits of a double service as one,
+   // identified by the visit of greater priority.
+   auto vertex = [&] (int id) {
+      const Visit &x = m_visits[id];
+      return x.partner != -1 && !x.first ? x.partner : id;
+   };
+   auto successor = [&] (int id, int k) {
+      const Visit &x = m_visits[k == 0 ? id : m_visits[id].partner];
+      return x.pos+1 < (int) m_routes[x.route].size() ? vertex(m_routes[x.route][x.pos+1]) : -1;
+   };
+
+   bool cyclic = false;
+   for (size_t q = 0; q < m_queue.size() && !cyclic; ++q) {
+      const int root = vertex(m_queue[q]);
+      if (m_color[root] || m_rank[root] > maxTail)
+         continue;
+      m_color[root] = 1;
+      m_touched.push_back(root);
+      m_stack.emplace_back(root, 0);
+      while (!m_stack.empty() && !cyclic) {
+         auto &[id, k] = m_stack.back();
+         const int arity = m_visits[id].partner != -1 ? 2 : 1;
+         if (k == arity) {
+            m_color[id] = 2;
+            m_stack.pop_back();
+            continue;
+         }
+         const int next = successor(id, k++);
+         if (next == -1 || m_rank[next] > maxTail || m_color[next] == 2)
+            continue;
+         if (m_color[next] == 1) {
+            cyclic = true;
+         } else {
+            m_color[next] = 1;
+            m_touched.push_back(next);
+            m_stack.emplace_back(next, 0);
+         }
+      }
+      m_stack.clear();
+   }
+
+   for (int id: m_touched)
+      m_color[id] = 0;
+   m_touched.clear();
+   if (cyclic) {
+      for (int id: m_queue)
+         m_queued[id] = 0;
+      m_queue.clear();
+   }
+   return !cyclic;
+}
+
+void LocalSearch::enqueue(int id) {
+   if (!m_queued[id]) {
+      m_queued[id] = 1;
+      m_queue.push_back(id);
+   }
+}
+
+bool LocalSearch::retime() {
+   // Unless the visits wait for each other in a cycle, the schedule settles
+   // after re-timing each visit a few times at most.
+   const size_t limit = 4*m_visits.size() + 64;
+   size_t head = 0;
+   for (; head < m_queue.size() && head < limit; ++head) {
+      const int id = m_queue[head];
+      m_queued[id] = 0;
+      const Visit &x = m_visits[id];
+      if (x.partner == -1) {
+         setStart(id, arrival(x));
+      } else {
+         double startX, startY;
+         syncStarts(x, m_visits[x.partner], startX, startY);
+         setStart(id, startX);
+         setStart(x.partner, startY);
+      }
+   }
+   stats.visitsRetimed += head;
+
+   const bool settled = head == m_queue.size();
+   for (; head < m_queue.size(); ++head)
+      m_queued[m_queue[head]] = 0;
+   m_queue.clear();
+   return settled;
+}
+
+void LocalSearch::setStart(int id, double start) {
+   Visit &x = m_visits[id];
+   if (start == x.start)
+      return;
+
+   if (!m_isSaved[id]) {
+      m_isSaved[id] = 1;
+      m_saved.push_back({id, x.start, x.leave, x.tard});
+   }
+
+   const double tard = max(0.0, start - m_inst.nodeTwMax(x.node));
+   m_deltaTard += tard - x.tard;
+   x.start = start;
+   x.leave = start + m_inst.nodeProcTime(x.node, x.skill);
+   x.tard = tard;
+
+   if (x.pos+1 < (int) m_routes[x.route].size())
+      enqueue(m_routes[x.route][x.pos+1]);
+}
@@ -0,0 +1,283 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include "Instance.h"
+#include "Solution.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Local search over the routes of a complete solution. The neighbourhoods are
+ * the relocation of a visit within its route or to another caregiver, the
+ * swap of two visits, 2-opt* between two routes (exchange of route tails) and
+ * the re-assignment of either caregiver of a double service.
+ *
+ * The start time of each visit is kept along with the routes, in the forward
+ * order of the schedule. Backwards, each visit keeps a bound on the tardiness
+ * that a change at it may remove: its own, that of the rest of its route, and
+ * that reached through the synchronisation of double services. The distance
+ * delta of a move takes O(1), and together with the bounds at the arcs the
+ * move changes, rejects most moves without touching the schedule.
+ *
+ * Moves that pass are evaluated exactly by following the new start times
+ * forward from the changed arcs, without applying the move, until they settle
+ * back to the current ones, so they cost O(k) in the k visits shifted. A
+ * shift that reaches a double service is followed into the route of its
+ * other visit, while that route is not already changed and at most
+ * `Evaluation::MAX_ROUTES` routes are. Otherwise, the move is applied and
+ * re-timed through the synchronisations, and undone if it does not improve
+ * the cost.
+ *
+ * With a granularity, a move is only considered if one of the arcs it creates
+ * goes into a visit from one of its nearest time-window compatible
+ * predecessors, or from the depot, as in the granular decoding.
+ *
+ * Moves are taken by first improvement. Start times follow the same rules as
+ * the decoder, so a decoded solution is evaluated to the same cost.
+ */
+class LocalSearch {
+public:
+   /// Counters of the moves, accumulated over the calls to `improve`.
+   struct Stats {
+      // Feasible moves considered, those rejected by their bounds, and those
+      // re-timed along with the number of visits re-timed.
+      uint64_t movesConsidered {0};
+      uint64_t movesBounded {0};
+      uint64_t movesRetimed {0};
+      uint64_t visitsRetimed {0};
+
+      // Moves evaluated exactly without applying them, and the visits
+      // followed to evaluate them.
+      uint64_t movesEvaluated {0};
+      uint64_t visitsFollowed {0};
+
+      // Moves discarded for creating a circular synchronisation.
+      uint64_t movesCyclic {0};
+
+      // Improving moves applied, by neighbourhood.
+      uint64_t relocations {0};
+      uint64_t swaps {0};
+      uint64_t twoOptStars {0};
+      uint64_t reassignments {0};
+   };
+
+   /// With `granularity` > 0, the moves are restricted to the lists of that
+   /// many nearest predecessors of `Instance::nearestPredecessors`.
+   explicit LocalSearch(const Instance &inst, int granularity = 0);
+
+   /**
+    * Improves `sol` until no move improves it, or `maxPasses` passes over
+    * all neighbourhoods. Returns true if the solution was improved, in which
+    * case its routes, insertion order and costs are rewritten.
+    */
+   bool improve(Solution &sol, int maxPasses = 100);
+
+   Stats stats;
+
+   /// The search stops at this time, keeping the moves already applied.
+   std::chrono::steady_clock::time_point deadline {std::chrono::steady_clock::time_point::max()};
+
+private:
+   struct Visit {
+      int node;
+      int skill;
+      int route;
+      int pos;
+
+      // The other visit of a double service, or -1. Precedences are taken
+      // from the visit of the skill with greater priority (`first`).
+      int partner;
+      bool first;
+
+      double start;
+      double leave;
+      double tard;
+
+      // Bound on the tardiness removed by any change at this visit.
+      double reach;
+   };
+
+   enum MoveKind {RELOCATE, SWAP, TWO_OPT_STAR};
+
+   /**
+    * Relocation of the visit at position `i` of route `a` to position `j` of
+    * route `b`, counted after removal. Swap of the visits at those positions.
+    * 2-opt* of the tails of `a` and `b` starting at those positions.
+    */
+   struct Move {
+      MoveKind kind;
+      int a, i;
+      int b, j;
+   };
+
+   void load(const Solution &sol);
+   void store(Solution &sol) const;
+
+   /// Computes all start times, costs and bounds from scratch. Returns
+   /// false if the synchronisations of the routes are circular.
+   bool schedule();
+
+   bool expired() const {
+      return deadline != std::chrono::steady_clock::time_point::max() &&
+         std::chrono::steady_clock::now() >= deadline;
+   }
+
+   double cost() const;
+   double arrival(const Visit &x) const;
+   void syncStarts(const Visit &x, const Visit &y, double &startX, double &startY) const;
+   void syncStarts(const Visit &x, double arrivalX, double arrivalY, double &startX, double &startY) const;
+
+   /// True if the arc from `pred` into `node` is in the granular lists.
+   bool isNeighbour(int node, int pred) const;
+   double reachAt(int route, int pos) const;
+
+   // Each neighbourhood takes the first improving move found from a visit
+   // (swaps with visits of greater index), or between two routes.
+   bool relocate(int id);
+   bool swapVisit(int id);
+   bool twoOptStar(int a, int b);
+
+   /// True if a move with such change of distance, that may remove up to
+   /// `reducible` of the tardiness, can improve the cost.
+   bool promising(double deltaDist, double reducible);
+
+   /// Change of the tardiness of the visits whose start times change, and
+   /// the routes changed.
+   struct Evaluation {
+      static constexpr int MAX_ROUTES = 3;
+
+      double tard {0.0};
+      double tmax {0.0};
+
+      // Visits that held the largest tardiness and are left below it.
+      int lost {0};
+
+      int routes[MAX_ROUTES];
+      int numRoutes {0};
+
+      void record(double before, double after, double largest) {
+         tard += after - before;
+         tmax = std::max(tmax, after);
+         lost += largest > 0.0 && before == largest && after < largest;
+      }
+
+      bool changes(int route) const {
+         return std::find(routes, routes + numRoutes, route) != routes + numRoutes;
+      }
+
+      /// False if too many routes are changed to be followed.
+      bool enter(int route) {
+         if (changes(route))
+            return true;
+         if (numRoutes == MAX_ROUTES)
+            return false;
+         routes[numRoutes++] = route;
+         return true;
+      }
+   };
+
+   /// False if the move is known not to improve the cost, by an exact
+   /// evaluation that leaves the solution untouched. True if it improves
+   /// it, or if it cannot be evaluated that way.
+   bool improves(const Move &mv, double deltaDist);
+
+   /// Start and leave times of `x` after `prevNode` leaving at `prevLeave`.
+   /// If it is a double service that shifts the other visit, follows the
+   /// route of that one. Returns false if that route is already changed.
+   bool visit(const Visit &x, int prevNode, double prevLeave, Evaluation &ev, double &leave, bool &unchanged);
+
+   /// Follows the start times of the visits of `route` from `pos` on, once
+   /// preceded by `prevNode` leaving at `prevLeave`, until they are the
+   /// current ones. Returns false if they cannot be followed exactly.
+   bool follow(int prevNode, double prevLeave, int route, int pos, Evaluation &ev);
+
+   /// Applies the move if it improves the cost, otherwise leaves the
+   /// solution unchanged.
+   bool attempt(const Move &mv, double deltaDist);
+   void apply(const Move &mv);
+   void renumber(int route, int from);
+
+   /// Queues the visits whose predecessor was changed by the move.
+   void seed(const Move &mv);
+
+   /// False if the arcs into the visits queued close a cycle of visits
+   /// waiting for each other through the synchronisations.
+   bool acyclic();
+
+   /// Re-timing of the visits queued, shifting the rest of the schedule as
+   /// needed. Returns false if it does not settle (circular synchronisation).
+   bool retime();
+   void setStart(int id, double start);
+   void enqueue(int id);
+
+   const Instance &m_inst;
+
+   int m_granularity;
+   std::vector <int> m_neighbours;
+
+   std::vector <Visit> m_visits;
+   std::vector <std::vector<int>> m_routes;
+
+   // Skill mask of the visits from each position to the end of each route.
+   std::vector <std::vector<uint64_t>> m_tailMask;
+
+   // Visits in the order they were scheduled, double services in pairs,
+   // and the rank of each visit in that order (the same for both visits of
+   // a double service).
+   std::vector <int> m_order;
+   std::vector <int> m_rank;
+   std::vector <int> m_next, m_ready, m_tail;
+
+   double m_dist {0.0};
+   double m_tard {0.0};
+   double m_tmax {0.0};
+   int m_tmaxCount {0};
+
+   // Re-timing queue, and the times of the visits re-timed by a tentative
+   // move, to restore them if the move is not taken.
+   struct Saved {
+      int id;
+      double start, leave, tard;
+   };
+   std::vector <int> m_queue;
+   std::vector <char> m_queued;
+   std::vector <Saved> m_saved;
+   std::vector <char> m_isSaved;
+
+   // Search for cycles.
+   std::vector <char> m_color;
+   std::vector <int> m_touched;
+   std::vector <std::pair<int,int>> m_stack;
+   double m_deltaTard {0.0};
+};
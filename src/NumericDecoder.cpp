@@ -0,0 +1,480 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "NumericDecoder.h"
+#include "Solution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const double C0 = DecodeState::COEFS[0];
+const double C1 = DecodeState::COEFS[1];
+const double C2 = DecodeState::COEFS[2];
+
+// Each arithmetic defines the type of times and distances (`Value`), the
+// type of the sums over the tasks (`Sum`), how the cost of a partial
+// solution is compared, and how its fitness is reported. The double one
+// mirrors the expressions of `InsertionKernels` operation by operation.
+
+struct DoubleArith {
+   typedef double Value;
+   typedef double Sum;
+
+   static Value convert(double x) {
+      return x;
+   }
+
+   static Sum cost(Sum dist, Sum tard, Value tmax) {
+      return C0 * dist + C1 * tard + C2 * tmax;
+   }
+
+   static Sum workload(Value w) {
+      return w;
+   }
+
+   static double fitness(Sum dist, Sum tard, Value tmax) {
+      return C0 * dist + C1 * tard + C2 * tmax;
+   }
+};
+
+struct Float32Arith {
+   typedef float Value;
+   typedef float Sum;
+
+   static Value convert(double x) {
+      return static_cast<float>(x);
+   }
+
+   static Sum cost(Sum dist, Sum tard, Value tmax) {
+      return static_cast<float>(C0) * dist + static_cast<float>(C1) * tard + static_cast<float>(C2) * tmax;
+   }
+
+   static Sum workload(Value w) {
+      return w;
+   }
+
+   static double fitness(Sum dist, Sum tard, Value tmax) {
+      return C0 * dist + C1 * tard + C2 * tmax;
+   }
+};
+
+struct Fixed32Arith {
+   typedef int32_t Value;
+   typedef int64_t Sum;
+
+   // Bound of the converted values, leaving room for sums of a few of them.
+   constexpr static int32_t LIMIT = 1 << 29;
+
+   static Value convert(double x) {
+      // Infinite bounds, e.g., the separation times of single services, saturate.
+      if (isinf(x))
+         return x > 0 ? LIMIT : -LIMIT;
+
+      const double scaled = x * NumericDecoder::FIXED_SCALE;
+      if (!(abs(scaled) < LIMIT))
+         throw runtime_error("value out of the range of the fixed-point mode: " + to_string(x));
+      return static_cast<Value>(llround(scaled));
+   }
+
+   // The coefficients of the objective are equal, so costs are compared by
+   // the plain sum of the indicators, which is exact.
+   static_assert(DecodeState::COEFS[0] == DecodeState::COEFS[1] && DecodeState::COEFS[1] == DecodeState::COEFS[2],
+      "Fixed-point costs require equal coefficients.");
+
+   static Sum cost(Sum dist, Sum tard, Value tmax) {
+      return dist + tard + tmax;
+   }
+
+   // Workloads are added to costs, scaled as the plain sum is.
+   static Sum workload(Value w) {
+      return llround(1.0 / C0) * w;
+   }
+
+   static double fitness(Sum dist, Sum tard, Value tmax) {
+      return (C0 * dist + C1 * tard + C2 * tmax) / NumericDecoder::FIXED_SCALE;
+   }
+};
+
+template <typename Arith>
+class NumericDecoderImpl: public NumericDecoder {
+public:
+   typedef typename Arith::Value Value;
+   typedef typename Arith::Sum Sum;
+
+   NumericDecoderImpl(NumericMode mode, const Instance &inst, const vector<Task> &tasks, int granularity,
+      const vector<int> &neighbours);
+
+   NumericMode mode() const override {
+      return m_mode;
+   }
+
+   size_t bytes() const override;
+
+   double decode(const vector<double> &chromosome, const vector<int> &taskIndices) const override;
+
+private:
+   /// State of the vehicles, and buffers of the candidates of a task.
+   struct Buffers {
+      vector<int> pos;
+
+      // Candidates of the granular lists.
+      vector<int> vehi;
+      vector<char> allowed;
+      vector<Instance::VehiclePair> pairs;
+
+      AlignedVector<Value> leave, wtime;
+      AlignedVector<Value> arrival, dist, depot;
+      AlignedVector<Sum> cost;
+   };
+
+   Value distance(int from, int to) const {
+      return m_dist[static_cast<size_t>(from) * m_stride + to];
+   }
+
+   Value procTime(int node, int skill) const {
+      return m_procTime[static_cast<size_t>(skill) * m_stride + node];
+   }
+
+   /// As `SortingDecoder::isNeighbour`.
+   bool isNeighbour(int node, int pred) const {
+      const int *list = &m_neighbours[static_cast<size_t>(node) * m_granularity];
+      for (int k = 0; k < m_granularity && list[k] >= 0; ++k)
+         if (list[k] == pred)
+            return true;
+      return false;
+   }
+
+   template <bool ConvHull, bool EnableHeur>
+   double decodeAs(const vector<double> &chromosome, const vector<int> &taskIndices, Buffers &buf) const;
+
+   template <bool ConvHull, bool EnableHeur, bool Sim>
+   void evalPairs(Span<Instance::VehiclePair> pairs, int node, Sum dist, Sum tard, Value tmax,
+      Buffers &buf) const;
+
+   /// Start times of a double service at a node, given the arrival times.
+   template <bool Sim>
+   void startTimes(int node, Value arrival0, Value arrival1, Value &start0, Value &start1) const {
+      if constexpr (Sim) {
+         start0 = max(arrival0, arrival1);
+         start1 = start0;
+      } else {
+         start0 = arrival0;
+         start1 = max(arrival1, start0 + m_deltaMin[node]);
+         start0 += max(Value(0), (start1 - start0) - m_deltaMax[node]);
+      }
+   }
+
+   NumericMode m_mode;
+   const Instance &m_inst;
+   vector<Task> m_tasks;
+   size_t m_maxCandidates;
+
+   int m_granularity;
+   vector<int> m_neighbours;
+
+   // Per-node data and rows of the distance matrix have `m_stride` elements.
+   int m_stride;
+   AlignedVector<Value> m_dist;
+   AlignedVector<Value> m_twMin, m_twMax, m_deltaMin, m_deltaMax;
+   AlignedVector<Value> m_procTime;
+};
+
+template <typename Arith>
+NumericDecoderImpl<Arith>::NumericDecoderImpl(NumericMode mode, const Instance &inst, const vector<Task> &tasks,
+      int granularity, const vector<int> &neighbours):
+      m_mode(mode), m_inst(inst), m_tasks(tasks), m_granularity(max(granularity, 0)), m_neighbours(neighbours) {
+   const int n = inst.numNodes();
+   m_stride = padToCacheLine<Value>(n);
+
+   m_maxCandidates = inst.numVehicles();
+   for (int i = 1; i < n-1; ++i)
+      m_maxCandidates = max(m_maxCandidates, inst.nodeVehiclePairs(i).size());
+
+   m_dist.assign(static_cast<size_t>(n) * m_stride, Value(0));
+   for (int i = 0; i < n; ++i)
+      for (int j = 0; j < n; ++j)
+         m_dist[static_cast<size_t>(i) * m_stride + j] = Arith::convert(inst.distance(i, j));
+
+   m_twMin.assign(m_stride, Value(0));
+   m_twMax.assign(m_stride, Value(0));
+   m_deltaMin.assign(m_stride, Value(0));
+   m_deltaMax.assign(m_stride, Value(0));
+   m_procTime.assign(static_cast<size_t>(inst.numSkills()) * m_stride, Value(0));
+   for (int i = 0; i < n; ++i) {
+      m_twMin[i] = Arith::convert(inst.nodeTwMin(i));
+      m_twMax[i] = Arith::convert(inst.nodeTwMax(i));
+      m_deltaMin[i] = Arith::convert(inst.nodeDeltaMin(i));
+      m_deltaMax[i] = Arith::convert(inst.nodeDeltaMax(i));
+      for (int s = 0; s < inst.numSkills(); ++s)
+         m_procTime[static_cast<size_t>(s) * m_stride + i] = Arith::convert(inst.nodeProcTime(i, s));
+   }
+}
+
+template <typename Arith>
+size_t NumericDecoderImpl<Arith>::bytes() const {
+   return sizeof(Value) * (m_dist.size() + m_twMin.size() + m_twMax.size() +
+      m_deltaMin.size() + m_deltaMax.size() + m_procTime.size());
+}
+
+template <typename Arith>
+double NumericDecoderImpl<Arith>::decode(const vector<double> &chromosome, const vector<int> &taskIndices) const {
+   // Buffers of the calling thread, resized only when the instance changes.
+   thread_local Buffers buf;
+   const int numVehicles = m_inst.numVehicles();
+   if (static_cast<int>(buf.pos.size()) != numVehicles || buf.cost.size() != m_maxCandidates) {
+      buf.pos.resize(numVehicles);
+      buf.vehi.resize(numVehicles);
+      buf.allowed.resize(numVehicles);
+      buf.pairs.resize(m_maxCandidates);
+      buf.leave.resize(numVehicles);
+      buf.wtime.resize(numVehicles);
+      buf.arrival.resize(numVehicles);
+      buf.dist.resize(numVehicles);
+      buf.depot.resize(numVehicles);
+      buf.cost.resize(m_maxCandidates);
+   }
+
+   const bool convHull = chromosome[chromosome.size()-2] >= 0.5;
+   const bool enableHeur = chromosome[chromosome.size()-1] >= 0.5;
+   if (convHull)
+      return enableHeur ? decodeAs<true, true>(chromosome, taskIndices, buf) :
+         decodeAs<true, false>(chromosome, taskIndices, buf);
+   else
+      return enableHeur ? decodeAs<false, true>(chromosome, taskIndices, buf) :
+         decodeAs<false, false>(chromosome, taskIndices, buf);
+}
+
+template <typename Arith>
+template <bool ConvHull, bool EnableHeur>
+double NumericDecoderImpl<Arith>::decodeAs(const vector<double> &chromosome, const vector<int> &taskIndices,
+      Buffers &buf) const {
+   fill(buf.pos.begin(), buf.pos.end(), 0);
+   fill(buf.leave.begin(), buf.leave.end(), Value(0));
+   fill(buf.wtime.begin(), buf.wtime.end(), Value(0));
+   Sum dist = 0, tard = 0;
+   Value tmax = 0;
+
+   const int numTasks = taskIndices.size();
+   for (int i = 0; i < numTasks; ++i) {
+      const Task &task = m_tasks[taskIndices[i]];
+      const int node = task.node;
+      const Value twMin = m_twMin[node];
+      const Value twMax = m_twMax[node];
+      const Value depotDist = distance(node, 0);
+
+      // Same rule of `SortingDecoder`: among the candidates tied with the
+      // smallest cost, the first or the last one, depending on the key.
+      const bool lastOfTies = chromosome[i] >= 0.5;
+      auto select = [&] (int n) {
+         int chosen = -1;
+         Sum bestCost = numeric_limits<Sum>::max();
+         for (int j = 0; j < n; ++j) {
+            const Sum c = buf.cost[j];
+            if (c < bestCost || (lastOfTies && c == bestCost)) {
+               bestCost = c;
+               chosen = j;
+            }
+         }
+         return chosen;
+      };
+
+      const Instance::SvcType svcType = m_inst.nodeSvcType(node);
+      if (svcType == Instance::SvcType::SINGLE) {
+         const auto qualified = m_inst.nodeQualifiedVehicles(node, 0);
+         const int *vehi = qualified.begin();
+         int n = qualified.size();
+
+         // As in `SortingDecoder`, only the vehicles at the depot or at a
+         // granular neighbour are evaluated, unless there is none of them.
+         if (m_granularity > 0) {
+            int m = 0;
+            for (int v: qualified) {
+               if (buf.pos[v] == 0 || isNeighbour(node, buf.pos[v]))
+                  buf.vehi[m++] = v;
+            }
+            if (m > 0) {
+               vehi = buf.vehi.data();
+               n = m;
+            }
+         }
+
+         for (int j = 0; j < n; ++j) {
+            const int pos = buf.pos[vehi[j]];
+            const Value d = distance(pos, node);
+            const Value arrival = max(twMin, buf.leave[vehi[j]] + d);
+            const Value tardiness = max(Value(0), arrival - twMax);
+            const Value incDist = ConvHull ? - distance(pos, 0) + d + depotDist : d;
+            buf.cost[j] = Arith::cost(dist + incDist, tard + tardiness, max(tmax, tardiness));
+         }
+
+         const int v = vehi[select(n)];
+         const int pos = buf.pos[v];
+         const Value d = distance(pos, node);
+         const Value arrival = max(twMin, buf.leave[v] + d);
+         const Value tardiness = max(Value(0), arrival - twMax);
+         dist += ConvHull ? - distance(pos, 0) + d + depotDist : d;
+         tard += tardiness;
+         tmax = max(tmax, tardiness);
+
+         const Value proc = procTime(node, task.skills[0]);
+         buf.leave[v] = arrival + proc;
+         buf.wtime[v] += proc;
+         buf.pos[v] = node;
+
+      } else {
+         for (int s = 0; s < 2; ++s) {
+            for (int v: m_inst.nodeQualifiedVehicles(node, s)) {
+               const int pos = buf.pos[v];
+               buf.dist[v] = distance(pos, node);
+               buf.arrival[v] = max(twMin, buf.leave[v] + buf.dist[v]);
+               if constexpr (ConvHull)
+                  buf.depot[v] = distance(pos, 0);
+               if (m_granularity > 0)
+                  buf.allowed[v] = pos == 0 || isNeighbour(node, pos);
+            }
+         }
+
+         auto pairs = m_inst.nodeVehiclePairs(node);
+         if (m_granularity > 0) {
+            int m = 0;
+            for (auto vp: pairs) {
+               if (buf.allowed[vp.v0] && buf.allowed[vp.v1])
+                  buf.pairs[m++] = vp;
+            }
+            if (m > 0)
+               pairs = Span<Instance::VehiclePair>(buf.pairs.data(), buf.pairs.data() + m);
+         }
+         const bool sim = svcType == Instance::SvcType::SIM;
+         if (sim)
+            evalPairs<ConvHull, EnableHeur, true>(pairs, node, dist, tard, tmax, buf);
+         else
+            evalPairs<ConvHull, EnableHeur, false>(pairs, node, dist, tard, tmax, buf);
+
+         const auto [v0, v1] = pairs[select(pairs.size())];
+         Value start0, start1;
+         if (sim)
+            startTimes<true>(node, buf.arrival[v0], buf.arrival[v1], start0, start1);
+         else
+            startTimes<false>(node, buf.arrival[v0], buf.arrival[v1], start0, start1);
+         const Value tardiness0 = max(Value(0), start0 - twMax);
+         const Value tardiness1 = max(Value(0), start1 - twMax);
+         dist += ConvHull ?
+            - buf.depot[v0] - buf.depot[v1] + buf.dist[v0] + buf.dist[v1] + depotDist + depotDist :
+            buf.dist[v0] + buf.dist[v1];
+         tard += tardiness0 + tardiness1;
+         tmax = max(tmax, max(tardiness0, tardiness1));
+
+         const Value proc0 = procTime(node, task.skills[0]);
+         const Value proc1 = procTime(node, task.skills[1]);
+         buf.leave[v0] = start0 + proc0;
+         buf.leave[v1] = start1 + proc1;
+         buf.wtime[v0] += proc0;
+         buf.wtime[v1] += proc1;
+         buf.pos[v0] = node;
+         buf.pos[v1] = node;
+      }
+   }
+
+   // Return to the depot.
+   if constexpr (!ConvHull) {
+      for (int v = 0; v < m_inst.numVehicles(); ++v)
+         dist += distance(buf.pos[v], 0);
+   }
+
+   return Arith::fitness(dist, tard, tmax);
+}
+
+template <typename Arith>
+template <bool ConvHull, bool EnableHeur, bool Sim>
+void NumericDecoderImpl<Arith>::evalPairs(Span<Instance::VehiclePair> pairs, int node, Sum dist, Sum tard,
+      Value tmax, Buffers &buf) const {
+   const Value twMax = m_twMax[node];
+   const Value depotDist = distance(node, 0);
+   const int n = pairs.size();
+
+   // Restricted pointers let the compiler vectorize the loop with gathers.
+   const Value *__restrict arrival = buf.arrival.data();
+   const Value *__restrict vehiDist = buf.dist.data();
+   const Value *__restrict vehiDepot = buf.depot.data();
+   const Value *__restrict wtime = buf.wtime.data();
+   Sum *__restrict cost = buf.cost.data();
+   const Instance::VehiclePair *vp = pairs.begin();
+
+   for (int j = 0; j < n; ++j) {
+      const int v0 = vp[j].v0;
+      const int v1 = vp[j].v1;
+      Value start0, start1;
+      startTimes<Sim>(node, arrival[v0], arrival[v1], start0, start1);
+      const Value tardiness0 = max(Value(0), start0 - twMax);
+      const Value tardiness1 = max(Value(0), start1 - twMax);
+      const Value incDist = ConvHull ?
+         - vehiDepot[v0] - vehiDepot[v1] + vehiDist[v0] + vehiDist[v1] + depotDist + depotDist :
+         vehiDist[v0] + vehiDist[v1];
+
+      Sum c = Arith::cost(dist + incDist, tard + (tardiness0 + tardiness1), max(tmax, max(tardiness0, tardiness1)));
+      if constexpr (EnableHeur)
+         c += Arith::workload(wtime[v1]);
+      cost[j] = c;
+   }
+}
+
+const char *const NUMERIC_MODE_NAMES[] = {"double", "float32", "fixed32"};
+
+}
+
+const char *numericModeName(NumericMode mode) {
+   return NUMERIC_MODE_NAMES[mode];
+}
+
+NumericMode numericModeFromName(const std::string &name) {
+   for (auto mode: {NUMERIC_DOUBLE, NUMERIC_FLOAT32, NUMERIC_FIXED32}) {
+      if (name == numericModeName(mode))
+         return mode;
+   }
+   throw runtime_error("unknown numeric mode: " + name);
+}
+
+unique_ptr<NumericDecoder> NumericDecoder::create(NumericMode mode, const Instance &inst,
+      const vector<Task> &tasks, int granularity, const vector<int> &neighbours) {
+   switch (mode) {
+      case NUMERIC_FLOAT32:
+         return make_unique<NumericDecoderImpl<Float32Arith>>(mode, inst, tasks, granularity, neighbours);
+      case NUMERIC_FIXED32:
+         return make_unique<NumericDecoderImpl<Fixed32Arith>>(mode, inst, tasks, granularity, neighbours);
+      default:
+         return make_unique<NumericDecoderImpl<DoubleArith>>(mode, inst, tasks, granularity, neighbours);
+   }
+}
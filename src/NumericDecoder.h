@@ -0,0 +1,89 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include "Instance.h"
+#include "Task.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Arithmetic used by the decoder for times, distances and costs.
+ */
+enum NumericMode {
+   // Double precision, as in `Instance` and `SortingDecoder`.
+   NUMERIC_DOUBLE,
+
+   // Single precision. Halves the memory of the tables, and doubles the
+   // number of lanes of vector instructions.
+   NUMERIC_FLOAT32,
+
+   // 32-bit integers counting `FIXED_SCALE`ths of the units of the instance.
+   // Time comparisons are exact, and sums do not depend on their order.
+   NUMERIC_FIXED32
+};
+
+const char *numericModeName(NumericMode mode);
+NumericMode numericModeFromName(const std::string &name);
+
+/**
+ * Cost-only decoder whose instance data and arithmetic are in the type of a
+ * numeric mode. It follows the rules of `SortingDecoder` (flags, order of
+ * the tasks, tie-breaking and granular lists), evaluating all candidates of
+ * each task without pruning, so that with NUMERIC_DOUBLE it computes exactly
+ * the same costs. The instance data is converted once into dense tables.
+ */
+class NumericDecoder {
+public:
+   /// Fixed-point values are rounded to thousandths of the instance units.
+   constexpr static int FIXED_SCALE = 1000;
+
+   virtual ~NumericDecoder() = default;
+
+   /**
+    * Converts the data of the instance. With `granularity` > 0, the
+    * candidates are restricted to the granular lists `neighbours`, laid out
+    * as those of `SortingDecoder`. Throws `std::runtime_error` if a finite
+    * value does not fit into the fixed-point representation.
+    */
+   static std::unique_ptr<NumericDecoder> create(NumericMode mode, const Instance &inst,
+      const std::vector<Task> &tasks, int granularity = 0, const std::vector<int> &neighbours = {});
+
+   virtual NumericMode mode() const = 0;
+
+   /// Memory used by the converted tables.
+   virtual size_t bytes() const = 0;
+
+   /// Cost of the chromosome, given the order of its tasks. Thread-safe.
+   virtual double decode(const std::vector<double> &chromosome, const std::vector<int> &taskIndices) const = 0;
+};
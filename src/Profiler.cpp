@@ -0,0 +1,137 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "Profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Registry {
+   mutex lock;
+   vector <string> names;
+   vector <unique_ptr<Profiler::ThreadBuffer>> buffers;
+
+   // Reference points of both clocks, to convert ticks into seconds.
+   Profiler::Ticks startTicks {Profiler::now()};
+   chrono::steady_clock::time_point startTime {chrono::steady_clock::now()};
+};
+
+Registry &registry() {
+   static Registry reg;
+   return reg;
+}
+
+}
+
+namespace Profiler {
+
+int zoneId(const char *name) {
+   auto &reg = registry();
+   lock_guard<mutex> guard(reg.lock);
+   auto it = find(reg.names.begin(), reg.names.end(), name);
+   if (it != reg.names.end())
+      return it - reg.names.begin();
+   if (reg.names.size() == MAX_ZONES)
+      throw runtime_error(string("too many profiler zones, adding ") + name);
+   reg.names.push_back(name);
+   return reg.names.size() - 1;
+}
+
+ThreadBuffer *registerThread() {
+   auto &reg = registry();
+   lock_guard<mutex> guard(reg.lock);
+   reg.buffers.emplace_back(make_unique<ThreadBuffer>());
+   return reg.buffers.back().get();
+}
+
+void report(ostream &out) {
+   auto &reg = registry();
+   lock_guard<mutex> guard(reg.lock);
+
+   const double wall = chrono::duration<double>(chrono::steady_clock::now() - reg.startTime).count();
+#ifdef PROFILER_USES_TSC
+   const double secondsPerTick = wall / max<double>(now() - reg.startTicks, 1);
+#else
+   const double secondsPerTick = 1e-9;
+#endif
+
+   struct Row {
+      int zone;
+      uint64_t calls;
+      Ticks total;
+      Ticks self;
+   };
+   vector <Row> rows;
+   for (size_t z = 0; z < reg.names.size(); ++z) {
+      Row row {int(z), 0, 0, 0};
+      for (const auto &buf: reg.buffers) {
+         row.calls += buf->calls[z];
+         row.total += buf->total[z];
+         row.self += buf->self[z];
+      }
+      if (row.calls > 0)
+         rows.push_back(row);
+   }
+   sort(rows.begin(), rows.end(), [] (const Row &a, const Row &b) {
+      return a.total > b.total;
+   });
+
+   const auto flags = out.flags();
+   const auto precision = out.precision();
+   out << "Profile of " << reg.buffers.size() << " threads over " << fixed << setprecision(3) <<
+      wall << " seconds (times summed over threads):\n";
+   out << setw(16) << "Zone" << " " << setw(12) << "Calls" << " " << setw(11) << "Total (s)" << " " <<
+      setw(11) << "Self (s)" << " " << setw(11) << "Mean (us)" << " " << setw(7) << "% wall" << "\n";
+   for (const auto &row: rows) {
+      const double total = row.total*secondsPerTick;
+      out << setw(16) << reg.names[row.zone] << " " <<
+         setw(12) << row.calls << " " <<
+         setw(11) << setprecision(3) << total << " " <<
+         setw(11) << setprecision(3) << row.self*secondsPerTick << " " <<
+         setw(11) << setprecision(3) << 1e6*total/row.calls << " " <<
+         setw(7) << setprecision(1) << 100.0*total/wall << "\n";
+   }
+   out.flags(flags);
+   out.precision(precision);
+}
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#if defined(PROFILER_TSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILER_USES_TSC
+#endif
+
+/**
+ * Scoped profiler of the phases of the algorithm. `PROFILE_ZONE("name")`
+ * times the rest of the enclosing scope, counting the time of each zone with
+ * and without the zones nested in it. Each thread accumulates its zones in a
+ * buffer of its own, and `Profiler::report` sums them.
+ *
+ * Only compiled in builds defining ENABLE_PROFILER, otherwise the zones
+ * expand to nothing. Defining PROFILER_TSC reads the time stamp counter of
+ * x86 processors instead of `steady_clock`, which is cheaper but assumes an
+ * invariant counter.
+ */
+#ifdef ENABLE_PROFILER
+
+namespace Profiler {
+
+/// Clock ticks: nanoseconds, or cycles of the time stamp counter.
+using Ticks = uint64_t;
+
+inline Ticks now() {
+#ifdef PROFILER_USES_TSC
+   return __rdtsc();
+#else
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+constexpr int MAX_ZONES = 64;
+
+class Zone;
+
+/// Totals of the zones of a thread, written only by that thread.
+struct alignas(64) ThreadBuffer {
+   uint64_t calls[MAX_ZONES] {};
+   Ticks total[MAX_ZONES] {};
+   Ticks self[MAX_ZONES] {};
+
+   // Innermost zone open in the thread.
+   Zone *open {nullptr};
+};
+
+/// Identifier of the zone with this name, registered on the first call.
+int zoneId(const char *name);
+
+/// Creates the buffer of the calling thread. Kept until the program exits.
+ThreadBuffer *registerThread();
+
+inline ThreadBuffer &threadBuffer() {
+   thread_local ThreadBuffer *buffer = nullptr;
+   if (!buffer)
+      buffer = registerThread();
+   return *buffer;
+}
+
+class Zone {
+public:
+   explicit Zone(int id): m_id(id), m_buffer(threadBuffer()), m_parent(m_buffer.open) {
+      m_buffer.open = this;
+      m_start = now();
+   }
+
+   ~Zone() {
+      const Ticks elapsed = now() - m_start;
+      m_buffer.calls[m_id]++;
+      m_buffer.total[m_id] += elapsed;
+      m_buffer.self[m_id] += elapsed - m_children;
+      if (m_parent)
+         m_parent->m_children += elapsed;
+      m_buffer.open = m_parent;
+   }
+
+   Zone(const Zone&) = delete;
+   Zone &operator=(const Zone&) = delete;
+
+private:
+   int m_id;
+   ThreadBuffer &m_buffer;
+   Zone *m_parent;
+   Ticks m_children {0};
+   Ticks m_start;
+};
+
+/// Prints the calls and times of each zone, summed over all threads, sorted
+/// by total time. Must not be called while zones are open in other threads.
+void report(std::ostream &out);
+
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) \
+   static const int PROFILE_CONCAT(profileZoneId, __LINE__) = Profiler::zoneId(name); \
+   Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(PROFILE_CONCAT(profileZoneId, __LINE__))
+
+#else
+
+#define PROFILE_ZONE(name) do {} while (false)
+
+#endif
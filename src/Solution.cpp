@@ -27,26 +27,29 @@
  */
 
 #include "Solution.h"
+#include "Profiler.h"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
 
 using namespace std;
 
-Solution::Solution(const Instance& inst_): inst(&inst_) {
+DecodeState::DecodeState(const Instance& inst_): inst(&inst_) {
    // Resizing of data structures
-   routes.resize(inst->numVehicles());
+   vehiPos.resize(inst->numVehicles());
+   vehiLeaveTime.resize(inst->numVehicles());
 
+   DecodeState::reset();
+}
+
+void DecodeState::reset() {
    // All vehicles start at depot node...
-   vehiPos.resize(inst->numVehicles(), 0);
-   for (int v = 0; v < inst->numVehicles(); ++v) {
-      routes[v].reserve(inst->numNodes());
-      routes[v].emplace_back(make_tuple(0, 0));
-   }
+   fill(vehiPos.begin(), vehiPos.end(), 0);
 
    // And are ready to leave at time 0.
-   vehiLeaveTime.resize(inst->numVehicles(), 0.0);
+   fill(vehiLeaveTime.begin(), vehiLeaveTime.end(), 0.0);
 
    // Initialize the solution cost indicators.
    dist = 0.0;
@@ -55,13 +58,30 @@ Solution::Solution(const Instance& inst_): inst(&inst_) {
    cachedCost = 0.0;
 }
 
-double Solution::findInsertionCost(Task &task) const {
+Solution::Solution(const Instance& inst_): DecodeState(inst_) {
+   // Double services take two visits, and each route two depot visits.
+   routes.visits.reserve(2*(inst->numNodes()-2) + 2*inst->numVehicles());
+   insertOrder.reserve(inst->numNodes()-2);
+
+   reset();
+}
+
+void Solution::reset() {
+   DecodeState::reset();
+   routes.visits.clear();
+   routes.offsets.assign(inst->numVehicles()+1, 0);
+   insertOrder.clear();
+}
+
+template <bool ConvHull, Instance::SvcType Svc>
+double DecodeState::insertionCost(Task &task) const {
    assert(task.vehi[0] != -1 && "First vehicle is unset.");
+   assert(inst->nodeSvcType(task.node) == Svc && "Service type of the patient does not match.");
 
    // Compute the arrival time of the first vehicle.
    double arrivalV0 = max(inst->nodeTwMin(task.node), vehiLeaveTime[task.vehi[0]] + inst->distance(vehiPos[task.vehi[0]], task.node));
 
-   if (inst->nodeSvcType(task.node) == Instance::SvcType::SINGLE) {
+   if constexpr (Svc == Instance::SvcType::SINGLE) {
 
       assert(task.skills[0] != -1 && "First skill for single service patient unset.");
       assert(task.skills[1] == -1 && "Second skill for single service patient set.");
@@ -71,7 +91,7 @@ double Solution::findInsertionCost(Task &task) const {
       task.leaveTime[0] = arrivalV0 + inst->nodeProcTime(task.node, task.skills[0]);
       task.leaveTime[1] = 0.0;
 
-      if (!convHull) {
+      if constexpr (!ConvHull) {
          task.incDist = inst->distance(vehiPos[task.vehi[0]], task.node);
       } else {
          task.incDist = 
@@ -90,7 +110,7 @@ double Solution::findInsertionCost(Task &task) const {
       // Computes the arrival time of the second vehicle.
       double arrivalV1 = max(inst->nodeTwMin(task.node), vehiLeaveTime[task.vehi[1]] + inst->distance(vehiPos[task.vehi[1]], task.node));
 
-      if (inst->nodeSvcType(task.node) == Instance::SvcType::SIM) {
+      if constexpr (Svc == Instance::SvcType::SIM) {
 
          assert(task.skills[0] != -1 && "First skill for simultaneous double service patient unset.");
          assert(task.skills[1] != -1 && "Second skill for simultaneous double service patient unset.");
@@ -106,7 +126,7 @@ double Solution::findInsertionCost(Task &task) const {
          task.leaveTime[0] = startTimeV0 + inst->nodeProcTime(task.node, task.skills[0]);
          task.leaveTime[1] = startTimeV1 + inst->nodeProcTime(task.node, task.skills[1]);
 
-         if (!convHull) {
+         if constexpr (!ConvHull) {
             task.incDist = inst->distance(vehiPos[task.vehi[0]], task.node) + inst->distance(vehiPos[task.vehi[1]], task.node);
          } else {
             task.incDist =
@@ -143,7 +163,7 @@ double Solution::findInsertionCost(Task &task) const {
          task.leaveTime[0] = startTimeV0 + inst->nodeProcTime(task.node, task.skills[0]);
          task.leaveTime[1] = startTimeV1 + inst->nodeProcTime(task.node, task.skills[1]);
 
-         if (!convHull) {
+         if constexpr (!ConvHull) {
             task.incDist = inst->distance(vehiPos[task.vehi[0]], task.node) + inst->distance(vehiPos[task.vehi[1]], task.node);
          } else {
             task.incDist =
@@ -170,11 +190,29 @@ double Solution::findInsertionCost(Task &task) const {
    return task.cachedCost;
 }
 
-void Solution::updateRoutes(const Task &task) {
+double DecodeState::findInsertionCost(Task &task) const {
+   switch (inst->nodeSvcType(task.node)) {
+      case Instance::SvcType::SINGLE:
+         return convHull ? insertionCost<true, Instance::SvcType::SINGLE>(task) : insertionCost<false, Instance::SvcType::SINGLE>(task);
+      case Instance::SvcType::SIM:
+         return convHull ? insertionCost<true, Instance::SvcType::SIM>(task) : insertionCost<false, Instance::SvcType::SIM>(task);
+      default:
+         return convHull ? insertionCost<true, Instance::SvcType::PRED>(task) : insertionCost<false, Instance::SvcType::PRED>(task);
+   }
+}
+
+template double DecodeState::insertionCost<false, Instance::SvcType::SINGLE>(Task &task) const;
+template double DecodeState::insertionCost<false, Instance::SvcType::SIM>(Task &task) const;
+template double DecodeState::insertionCost<false, Instance::SvcType::PRED>(Task &task) const;
+template double DecodeState::insertionCost<true, Instance::SvcType::SINGLE>(Task &task) const;
+template double DecodeState::insertionCost<true, Instance::SvcType::SIM>(Task &task) const;
+template double DecodeState::insertionCost<true, Instance::SvcType::PRED>(Task &task) const;
+
+void DecodeState::updateRoutes(const Task &task) {
+   PROFILE_ZONE("updateRoutes");
    assert(task.skills[0] != -1 && "First skill for simultaneous double service patient unset.");
    assert(task.vehi[0] != -1 && "Vehicle for the first skill unset.");
 
-   routes[task.vehi[0]].push_back(make_tuple(task.node, task.skills[0]));
    vehiPos[task.vehi[0]] = task.node;
    vehiLeaveTime[task.vehi[0]] = task.leaveTime[0];
 
@@ -182,7 +220,6 @@ void Solution::updateRoutes(const Task &task) {
       assert(task.skills[1] != -1 && "Second skill for simultaneous double service patient unset.");
       assert(task.vehi[1] != -1 && "Vehicle for the second skill unset.");
 
-      routes[task.vehi[1]].push_back(make_tuple(task.node, task.skills[1]));
       vehiPos[task.vehi[1]] = task.node;
       vehiLeaveTime[task.vehi[1]] = task.leaveTime[1];
    }
@@ -192,16 +229,13 @@ void Solution::updateRoutes(const Task &task) {
    tmax = max(tmax, task.currTmax);
 
    cachedCost = task.cachedCost;
-   insertOrder.push_back(task);
 }
 
-void Solution::finishRoutes() {
+void DecodeState::finishRoutes() {
    // Add the depot node at the end of each vehicle route.
    for (int v = 0; v < inst->numVehicles(); ++v) {
-      int lastNode = get<0>(routes[v].back());
       if (!convHull)
-         dist += inst->distance(lastNode, 0);
-      routes[v].push_back(make_tuple(0, 0));
+         dist += inst->distance(vehiPos[v], 0);
    }
 
    // Update the solution to take into account the distances on returning to depot.
@@ -211,14 +245,62 @@ void Solution::finishRoutes() {
       COEFS[2] * tmax;
 }
 
+void Solution::updateRoutes(const Task &task) {
+   DecodeState::updateRoutes(task);
+   insertOrder.push_back(task);
+}
+
+void Solution::finishRoutes() {
+   DecodeState::finishRoutes();
+
+   // Counts the visits of each route in offsets[v+1], then turns the counts
+   // into the first position of each route, and advances them while placing
+   // the visits. Each offsets[v+1] ends at the end of route v.
+   const int numVehicles = inst->numVehicles();
+   auto &offsets = routes.offsets;
+   offsets.assign(numVehicles+1, 2);
+   offsets[0] = 0;
+   for (const Task &task: insertOrder) {
+      ++offsets[task.vehi[0]+1];
+      if (task.skills[1] != -1)
+         ++offsets[task.vehi[1]+1];
+   }
+   int total = 0;
+   for (int v = 0; v < numVehicles; ++v) {
+      const int count = offsets[v+1];
+      offsets[v+1] = total;
+      total += count;
+   }
+
+   auto &visits = routes.visits;
+   visits.resize(total);
+   for (int v = 0; v < numVehicles; ++v)
+      visits[offsets[v+1]++] = RouteVisit{0, 0, 0.0};
+   for (const Task &task: insertOrder) {
+      for (int k = 0; k < 2 && task.skills[k] != -1; ++k) {
+         const double start = task.leaveTime[k] - inst->nodeProcTime(task.node, task.skills[k]);
+         visits[offsets[task.vehi[k]+1]++] = RouteVisit{task.node, task.skills[k], start};
+      }
+   }
+   for (int v = 0; v < numVehicles; ++v) {
+      const double back = vehiLeaveTime[v] + inst->distance(vehiPos[v], 0);
+      visits[offsets[v+1]++] = RouteVisit{0, 0, back};
+   }
+}
+
 void Solution::writeFile(const char fname[], const int seed) const {
    ofstream fid(fname);
-   fid << "# Instance: " << inst->fileName() << "\n";
-   fid << "# Seed: " << seed << "\n";
-   fid << "# Cost: " << cachedCost << ", dist: " << dist << ", tard: " << tard << ", tmax: " << tmax << "\n";
-   for (int v = 0; v < inst->numVehicles(); ++v) {
-      fid << routes[v].size() << "\n";
-      for (auto [i,s]: routes[v])
-      fid << i << ' ' << s << "\n";
+   writeSolutionText(fid, inst->fileName(), seed, cachedCost, dist, tard, tmax, routes);
+}
+
+void writeSolutionText(std::ostream &out, const std::string &instanceName, int seed,
+   double cost, double dist, double tard, double tmax, const RouteArena &routes) {
+   out << "# Instance: " << instanceName << "\n";
+   out << "# Seed: " << seed << "\n";
+   out << "# Cost: " << cost << ", dist: " << dist << ", tard: " << tard << ", tmax: " << tmax << "\n";
+   for (int v = 0; v < routes.numRoutes(); ++v) {
+      out << routes[v].size() << "\n";
+      for (const RouteVisit &visit: routes[v])
+         out << visit.node << ' ' << visit.skill << "\n";
    }
 }
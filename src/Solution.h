@@ -28,25 +28,23 @@
 
 #pragma once
 
+#include <ostream>
+#include <string>
 #include <vector>
 
 #include "Instance.h"
+#include "Span.h"
 #include "Task.h"
 
-struct Solution {
+/// State of the constructive decoding required to evaluate insertions and
+/// the objective: position and leave time of each vehicle, and the cost
+/// indicators. The GA fitness is computed on this state alone.
+struct DecodeState {
    constexpr static double ONE_THIRD = 1.0/3.0;
    constexpr static double COEFS[] = {ONE_THIRD, ONE_THIRD, ONE_THIRD}; // 0:dist, 1:tard, 2:tmax
 
    const Instance *inst;
 
-   // [vehicle] -> route
-   // get<0> -> node
-   // get<1> -> skill
-   std::vector <std::vector<std::tuple<int,int>>> routes;
-
-   // Task insertion order.
-   std::vector <Task> insertOrder;
-
    // Toggles if the `findInsertionCost` method should take 
    // into account arc connecting the nodes to depot at the end of routes.
    // Similar to the trivial convex hull-based heuristic for the TSP.
@@ -60,13 +58,78 @@ struct Solution {
    double tmax;
    double cachedCost;
 
-   Solution(const Instance &inst_);
+   DecodeState(const Instance &inst_);
+
+   /// Restores the empty state, keeping the memory already allocated.
+   void reset();
 
    double findInsertionCost(Task &task) const;
+
+   /// Same as `findInsertionCost`, specialized for the convex hull flag and
+   /// the service type of the patient. Instantiated for all combinations.
+   template <bool ConvHull, Instance::SvcType Svc>
+   double insertionCost(Task &task) const;
    
    void updateRoutes(const Task &task);
    void finishRoutes();
+};
+
+/// Visit of a route to a patient, or to the depot (node 0, skill 0) at both
+/// ends. The start time of the depot visits are the times of leaving and
+/// returning to it.
+struct RouteVisit {
+   int node;
+   int skill;
+   double start;
+};
+
+/**
+ * Routes of all vehicles, stored one after the other in a single buffer.
+ * The route of vehicle v takes the visits from `offsets[v]` to
+ * `offsets[v+1]`, so the memory is linear in the number of visits and
+ * vehicles, and copying the routes copies two flat arrays.
+ *
+ * Copying a whole `Solution` is not a single memcpy, though: it copies
+ * five flat arrays, namely `vehiPos` and `vehiLeaveTime` of the decoding
+ * state, `visits` and `offsets` of the routes, and `insertOrder`. Each is
+ * one allocation and one contiguous copy, independent of the number of
+ * routes.
+ */
+struct RouteArena {
+   std::vector <RouteVisit> visits;
+   std::vector <int> offsets;
+
+   int numRoutes() const {
+      return int(offsets.size()) - 1;
+   }
+
+   Span<RouteVisit> operator[](int vehicle) const {
+      return Span<RouteVisit>(visits.data() + offsets[vehicle], visits.data() + offsets[vehicle+1]);
+   }
+};
+
+/// Complete solution, which also records the routes and the insertion order.
+/// Costs are computed by the base class, so they match those of a
+/// `DecodeState` built by the same sequence of insertions bit by bit.
+struct Solution: DecodeState {
+   // Laid out from the insertion order by `finishRoutes`. Until then, all
+   // routes are empty.
+   RouteArena routes;
+
+   // Task insertion order.
+   std::vector <Task> insertOrder;
+
+   Solution(const Instance &inst_);
+
+   /// Restores the empty solution, keeping the memory already allocated.
+   void reset();
+
+   void updateRoutes(const Task &task);
+   void finishRoutes();
 
    void writeFile(const char fname[], const int seed = -1) const;
 };
 
+/// Writes routes in the text format of the solution files.
+void writeSolutionText(std::ostream &out, const std::string &instanceName, int seed,
+   double cost, double dist, double tard, double tmax, const RouteArena &routes);
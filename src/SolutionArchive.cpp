@@ -0,0 +1,302 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "SolutionArchive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+/*
+ * Layout of the archive. A header:
+ *    - magic, version, byte order, seed, length of the instance name
+ *    - instance name (not terminated)
+ * followed by records, each one made of:
+ *    - RecordHeader, whose `size` counts the bytes after that field
+ *    - chromosome,   double [chromosomeLength]
+ *    - offsets,      int32 [numRoutes+1]
+ *    - visits,       {int32 node, int32 skill, double start} [numVisits]
+ * Multi-byte values are stored in the byte order of the machine that wrote
+ * the file, as in the binary instance cache.
+ */
+constexpr char ARC_MAGIC[8] = {'H', 'H', 'C', 'R', 'S', 'P', 'A', '\0'};
+constexpr uint32_t ARC_VERSION = 1;
+constexpr uint32_t ARC_BYTE_ORDER = 0x01020304;
+
+// Flags of a record.
+constexpr uint32_t REC_POST_OPTIMISED = 1;
+
+struct ArchiveHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t byteOrder;
+   int32_t seed;
+   uint32_t nameLength;
+};
+
+struct RecordHeader {
+   uint32_t size;
+   uint32_t generation;
+   uint32_t chromosomeLength;
+   uint32_t numRoutes;
+   uint32_t numVisits;
+   uint32_t flags;
+   int64_t timestamp;
+   double elapsed;
+   double cost;
+   double dist;
+   double tard;
+   double tmax;
+};
+
+static_assert(sizeof(RouteVisit) == 2*sizeof(int32_t) + sizeof(double), "Route visits are not packed.");
+static_assert(sizeof(int) == sizeof(int32_t), "Route offsets are not 32-bit integers.");
+
+template <typename T>
+void append(vector <char> &buf, const T *data, size_t count) {
+   const char *bytes = reinterpret_cast<const char*>(data);
+   buf.insert(buf.end(), bytes, bytes + count*sizeof(T));
+}
+
+}
+
+SolutionArchive::SolutionArchive(const string &fname, const string &instanceName, int seed):
+   m_created(chrono::steady_clock::now()) {
+   create(fname, instanceName, seed);
+   m_writer = thread(&SolutionArchive::writerLoop, this);
+}
+
+SolutionArchive::SolutionArchive(const string &fname, const string &instanceName, int seed,
+      unsigned generation, double elapsed):
+   m_created(chrono::steady_clock::now() - chrono::duration_cast<chrono::steady_clock::duration>(
+      chrono::duration<double>(elapsed))) {
+
+   if (!ifstream(fname)) {
+      create(fname, instanceName, seed);
+   } else {
+      vector <uint64_t> ends;
+      const auto contents = parse(fname, &ends);
+      if (contents.instanceName != instanceName || contents.seed != seed) {
+         throw runtime_error(fname + ": solution archive of instance '" + contents.instanceName +
+            "' and seed " + to_string(contents.seed) + ", not of the resumed run");
+      }
+
+      // Records are in the order of their generations.
+      size_t kept = 0;
+      while (kept < contents.records.size() && contents.records[kept].generation < generation)
+         ++kept;
+      if (truncate(fname.c_str(), ends[kept]) != 0) {
+         throw runtime_error(fname + ": solution archive could not be truncated: " + strerror(errno));
+      }
+      m_file.open(fname, ios::binary | ios::app);
+      if (!m_file) {
+         throw runtime_error(fname + ": solution archive could not be opened");
+      }
+   }
+
+   m_writer = thread(&SolutionArchive::writerLoop, this);
+}
+
+void SolutionArchive::create(const string &fname, const string &instanceName, int seed) {
+   m_file.open(fname, ios::binary | ios::trunc);
+   if (!m_file) {
+      throw runtime_error(fname + ": solution archive could not be created");
+   }
+
+   ArchiveHeader hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, ARC_MAGIC, sizeof(ARC_MAGIC));
+   hdr.version = ARC_VERSION;
+   hdr.byteOrder = ARC_BYTE_ORDER;
+   hdr.seed = seed;
+   hdr.nameLength = instanceName.size();
+   m_file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+   m_file.write(instanceName.data(), instanceName.size());
+   m_file.flush();
+   if (!m_file) {
+      throw runtime_error(fname + ": solution archive could not be written");
+   }
+}
+
+SolutionArchive::~SolutionArchive() {
+   close();
+}
+
+void SolutionArchive::close() {
+   {
+      lock_guard<mutex> lock(m_mutex);
+      m_stop = true;
+   }
+   m_wake.notify_one();
+   if (m_writer.joinable())
+      m_writer.join();
+}
+
+void SolutionArchive::record(const Solution &sol, const vector <double> &chromosome, unsigned generation,
+      bool postOptimised) {
+   const auto &routes = sol.routes;
+
+   RecordHeader hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   hdr.generation = generation;
+   hdr.chromosomeLength = chromosome.size();
+   hdr.numRoutes = routes.numRoutes();
+   hdr.numVisits = routes.visits.size();
+   hdr.flags = postOptimised ? REC_POST_OPTIMISED : 0;
+   hdr.timestamp = chrono::duration_cast<chrono::milliseconds>(
+      chrono::system_clock::now().time_since_epoch()).count();
+   hdr.elapsed = chrono::duration<double>(chrono::steady_clock::now() - m_created).count();
+   hdr.cost = sol.cachedCost;
+   hdr.dist = sol.dist;
+   hdr.tard = sol.tard;
+   hdr.tmax = sol.tmax;
+
+   vector <char> buf;
+   buf.reserve(sizeof(hdr) + chromosome.size()*sizeof(double) +
+      routes.offsets.size()*sizeof(int32_t) + routes.visits.size()*sizeof(RouteVisit));
+   append(buf, &hdr, 1);
+   append(buf, chromosome.data(), chromosome.size());
+   append(buf, routes.offsets.data(), routes.offsets.size());
+   append(buf, routes.visits.data(), routes.visits.size());
+   const uint32_t size = buf.size() - sizeof(hdr.size);
+   memcpy(buf.data(), &size, sizeof(size));
+
+   {
+      lock_guard<mutex> lock(m_mutex);
+      if (m_stop)
+         return;
+      m_pending.push_back(move(buf));
+   }
+   m_wake.notify_one();
+}
+
+void SolutionArchive::writerLoop() {
+   vector <vector<char>> batch;
+   unique_lock<mutex> lock(m_mutex);
+   for (;;) {
+      m_wake.wait(lock, [this] {
+         return m_stop || !m_pending.empty();
+      });
+      if (m_pending.empty())
+         break;
+      batch.swap(m_pending);
+      lock.unlock();
+
+      // Each batch is flushed, so that the archive survives an interrupted run.
+      for (const auto &buf: batch)
+         m_file.write(buf.data(), buf.size());
+      m_file.flush();
+      if (m_file)
+         m_written.fetch_add(batch.size(), memory_order_relaxed);
+      else
+         m_failed.store(true, memory_order_relaxed);
+      batch.clear();
+
+      lock.lock();
+   }
+}
+
+SolutionArchive::Contents SolutionArchive::read(const string &fname) {
+   return parse(fname, nullptr);
+}
+
+SolutionArchive::Contents SolutionArchive::parse(const string &fname, vector <uint64_t> *ends) {
+   ifstream fid(fname, ios::binary);
+   if (!fid) {
+      throw runtime_error(fname + ": solution archive could not be read");
+   }
+   const vector <char> data((istreambuf_iterator<char>(fid)), istreambuf_iterator<char>());
+
+   ArchiveHeader hdr;
+   if (data.size() < sizeof(hdr)) {
+      throw runtime_error(fname + ": not a solution archive");
+   }
+   memcpy(&hdr, data.data(), sizeof(hdr));
+   if (memcmp(hdr.magic, ARC_MAGIC, sizeof(ARC_MAGIC)) != 0 || hdr.byteOrder != ARC_BYTE_ORDER ||
+         hdr.version != ARC_VERSION || sizeof(hdr) + hdr.nameLength > data.size()) {
+      throw runtime_error(fname + ": not a solution archive, or written by an incompatible version");
+   }
+
+   Contents contents;
+   contents.seed = hdr.seed;
+   contents.instanceName.assign(data.data() + sizeof(hdr), hdr.nameLength);
+
+   size_t pos = sizeof(hdr) + hdr.nameLength;
+   if (ends)
+      ends->push_back(pos);
+   RecordHeader rec;
+   while (pos + sizeof(rec) <= data.size()) {
+      memcpy(&rec, data.data() + pos, sizeof(rec));
+      const size_t size = sizeof(rec.size) + size_t(rec.size);
+      const size_t expected = sizeof(rec) + rec.chromosomeLength*sizeof(double) +
+         (rec.numRoutes+1)*sizeof(int32_t) + size_t(rec.numVisits)*sizeof(RouteVisit);
+      if (pos + size > data.size() || size != expected)
+         break;
+
+      Record &r = contents.records.emplace_back();
+      r.generation = rec.generation;
+      r.elapsed = rec.elapsed;
+      r.timestamp = rec.timestamp;
+      r.cost = rec.cost;
+      r.dist = rec.dist;
+      r.tard = rec.tard;
+      r.tmax = rec.tmax;
+      r.postOptimised = rec.flags & REC_POST_OPTIMISED;
+
+      const char *body = data.data() + pos + sizeof(rec);
+      r.chromosome.resize(rec.chromosomeLength);
+      memcpy(r.chromosome.data(), body, rec.chromosomeLength*sizeof(double));
+      body += rec.chromosomeLength*sizeof(double);
+      r.routes.offsets.resize(rec.numRoutes+1);
+      memcpy(r.routes.offsets.data(), body, (rec.numRoutes+1)*sizeof(int32_t));
+      body += (rec.numRoutes+1)*sizeof(int32_t);
+      r.routes.visits.resize(rec.numVisits);
+      memcpy(r.routes.visits.data(), body, rec.numVisits*sizeof(RouteVisit));
+
+      const auto &offsets = r.routes.offsets;
+      if (offsets.front() != 0 || offsets.back() != int(rec.numVisits) ||
+            !is_sorted(offsets.begin(), offsets.end())) {
+         contents.records.pop_back();
+         break;
+      }
+      pos += size;
+      if (ends)
+         ends->push_back(pos);
+   }
+
+   return contents;
+}
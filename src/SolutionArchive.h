@@ -0,0 +1,137 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include "Solution.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Append-only binary archive of the solutions found during a run, written
+ * by a background thread. `record` serialises a solution in the calling
+ * thread and queues it, so the search never waits for the disk. A record
+ * that was not completely written when the run was interrupted is ignored
+ * when reading the archive.
+ */
+class SolutionArchive {
+public:
+   /// Record of an archive, as read back.
+   struct Record {
+      uint32_t generation;
+
+      // Seconds since the archive was created, and milliseconds since the
+      // epoch.
+      double elapsed;
+      int64_t timestamp;
+
+      double cost;
+      double dist;
+      double tard;
+      double tmax;
+
+      // Routes improved by the local search. The chromosome is the one the
+      // search started from, which does not decode to these routes.
+      bool postOptimised;
+
+      std::vector <double> chromosome;
+      RouteArena routes;
+   };
+
+   /// Contents of an archive.
+   struct Contents {
+      std::string instanceName;
+      int seed;
+      std::vector <Record> records;
+   };
+
+   /// Creates the archive, replacing any file with the same name, and starts
+   /// the writer thread. Throws `std::runtime_error` if it cannot be created.
+   SolutionArchive(const std::string &fname, const std::string &instanceName, int seed);
+
+   /// Reopens the archive of an interrupted run to append to it, or creates
+   /// it if missing. The records of generations from `generation` on, which
+   /// the resumed run records again, are dropped along with an incomplete
+   /// last record, and elapsed times continue from `elapsed` seconds. Throws
+   /// `std::runtime_error` if the archive is of another instance or seed.
+   SolutionArchive(const std::string &fname, const std::string &instanceName, int seed,
+      unsigned generation, double elapsed);
+
+   ~SolutionArchive();
+
+   /// Writes the records still queued and stops the writer thread. Records
+   /// queued afterwards are discarded.
+   void close();
+
+   void record(const Solution &sol, const std::vector <double> &chromosome, unsigned generation,
+      bool postOptimised = false);
+
+   /// Records written so far, and whether a write failed.
+   uint64_t recordsWritten() const {
+      return m_written.load(std::memory_order_relaxed);
+   }
+
+   bool failed() const {
+      return m_failed.load(std::memory_order_relaxed);
+   }
+
+   /// Reads all complete records of an archive. Throws `std::runtime_error`
+   /// if it is not an archive.
+   static Contents read(const std::string &fname);
+
+private:
+   /// Writes the header of a new archive.
+   void create(const std::string &fname, const std::string &instanceName, int seed);
+
+   /// As `read`, also giving the size of the file up to the end of each record.
+   static Contents parse(const std::string &fname, std::vector <uint64_t> *ends);
+
+   void writerLoop();
+
+   std::ofstream m_file;
+   std::chrono::steady_clock::time_point m_created;
+
+   std::mutex m_mutex;
+   std::condition_variable m_wake;
+   std::vector <std::vector<char>> m_pending;
+   bool m_stop {false};
+
+   std::atomic <uint64_t> m_written {0};
+   std::atomic <bool> m_failed {false};
+
+   std::thread m_writer;
+};
@@ -0,0 +1,277 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "SolverState.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+
+/*
+ * Layout of the file:
+ *    - StateHeader
+ *    - PRNG state,   char [rngLength]
+ * then, for each population:
+ *    - fitness,      {double value, uint32 index} [populationSize]
+ *    - chromosomes,  double [populationSize][chromosomeLength]
+ * and the routes of the best solution:
+ *    - offsets,      int32 [numOffsets]
+ *    - visits,       {int32 node, int32 skill, double start} [numVisits]
+ * and the chromosomes of the last local search:
+ *    - searched,     double [numSearched][chromosomeLength]
+ * Multi-byte values are stored in the byte order of the machine that wrote
+ * the file, as in the binary instance cache.
+ */
+constexpr char STATE_MAGIC[8] = {'H', 'H', 'C', 'R', 'S', 'P', 'S', '\0'};
+constexpr uint32_t STATE_VERSION = 4;
+constexpr uint32_t STATE_BYTE_ORDER = 0x01020304;
+
+struct StateHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t byteOrder;
+   int32_t seed;
+   uint32_t chromosomeLength;
+   uint32_t numPopulations;
+   uint32_t populationSize;
+   uint32_t rngLength;
+
+   uint32_t generation;
+   int32_t noImprove;
+   int32_t opIpr;
+   int32_t opXe;
+   int32_t opRst;
+   int32_t iprHomogeneous;
+   int32_t iprNoImprovement;
+   int32_t iprEliteImprovement;
+   int32_t iprBestImprovement;
+   uint64_t evaluations;
+   uint64_t evalsToBest;
+   double timeToBest;
+   double elapsed;
+   double localBest;
+   double overallBest;
+   double dist;
+   double tard;
+   double tmax;
+   double bestFitness;
+   uint32_t numOffsets;
+   uint32_t numVisits;
+   int32_t opLs;
+   int32_t lsInjected;
+   double lsSeconds;
+   uint32_t numSearched;
+   uint32_t padding;
+};
+
+static_assert(sizeof(RouteVisit) == 2*sizeof(int32_t) + sizeof(double), "Route visits are not packed.");
+static_assert(sizeof(int) == sizeof(int32_t), "Route offsets are not 32-bit integers.");
+
+struct FitnessEntry {
+   double value;
+   uint32_t index;
+   uint32_t padding;
+};
+
+}
+
+void SolverState::write(const string &fname) const {
+   StateHeader hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, STATE_MAGIC, sizeof(STATE_MAGIC));
+   hdr.version = STATE_VERSION;
+   hdr.byteOrder = STATE_BYTE_ORDER;
+   hdr.seed = seed;
+   hdr.chromosomeLength = chromosomeLength;
+   hdr.numPopulations = populations.size();
+   hdr.populationSize = populations.empty() ? 0 : populations[0].chromosomes.size();
+   hdr.rngLength = rngState.size();
+   hdr.generation = generation;
+   hdr.noImprove = noImprove;
+   hdr.opIpr = opIpr;
+   hdr.opXe = opXe;
+   hdr.opRst = opRst;
+   hdr.iprHomogeneous = iprHomogeneous;
+   hdr.iprNoImprovement = iprNoImprovement;
+   hdr.iprEliteImprovement = iprEliteImprovement;
+   hdr.iprBestImprovement = iprBestImprovement;
+   hdr.evaluations = evaluations;
+   hdr.evalsToBest = evalsToBest;
+   hdr.timeToBest = timeToBest;
+   hdr.elapsed = elapsed;
+   hdr.localBest = localBest;
+   hdr.overallBest = overallBest;
+   hdr.dist = dist;
+   hdr.tard = tard;
+   hdr.tmax = tmax;
+   hdr.bestFitness = bestFitness;
+   hdr.numOffsets = bestRoutes.offsets.size();
+   hdr.numVisits = bestRoutes.visits.size();
+   hdr.opLs = opLs;
+   hdr.lsInjected = lsInjected;
+   hdr.lsSeconds = lsSeconds;
+   hdr.numSearched = searched.size();
+
+   const string tmpName = fname + ".tmp";
+   {
+      ofstream fid(tmpName, ios::binary | ios::trunc);
+      if (!fid) {
+         throw runtime_error(tmpName + ": solver state could not be created");
+      }
+      fid.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+      fid.write(rngState.data(), rngState.size());
+
+      vector <FitnessEntry> entries;
+      for (const auto &pop: populations) {
+         if (pop.chromosomes.size() != hdr.populationSize || pop.fitness.size() != hdr.populationSize) {
+            throw runtime_error(fname + ": populations of the solver state differ in size");
+         }
+         entries.resize(pop.fitness.size());
+         for (size_t i = 0; i < entries.size(); ++i)
+            entries[i] = FitnessEntry {pop.fitness[i].first, pop.fitness[i].second, 0};
+         fid.write(reinterpret_cast<const char*>(entries.data()), entries.size()*sizeof(FitnessEntry));
+         for (const auto &chromosome: pop.chromosomes)
+            fid.write(reinterpret_cast<const char*>(chromosome.data()), chromosomeLength*sizeof(double));
+      }
+      fid.write(reinterpret_cast<const char*>(bestRoutes.offsets.data()), bestRoutes.offsets.size()*sizeof(int32_t));
+      fid.write(reinterpret_cast<const char*>(bestRoutes.visits.data()), bestRoutes.visits.size()*sizeof(RouteVisit));
+      for (const auto &chromosome: searched) {
+         if (chromosome.size() != chromosomeLength) {
+            throw runtime_error(fname + ": searched chromosome of the solver state has a different length");
+         }
+         fid.write(reinterpret_cast<const char*>(chromosome.data()), chromosomeLength*sizeof(double));
+      }
+      fid.flush();
+      if (!fid) {
+         throw runtime_error(tmpName + ": solver state could not be written");
+      }
+   }
+   if (rename(tmpName.c_str(), fname.c_str()) != 0) {
+      throw runtime_error(fname + ": solver state could not be replaced: " + strerror(errno));
+   }
+}
+
+SolverState SolverState::read(const string &fname) {
+   ifstream fid(fname, ios::binary);
+   if (!fid) {
+      throw runtime_error(fname + ": solver state could not be read");
+   }
+   const vector <char> data((istreambuf_iterator<char>(fid)), istreambuf_iterator<char>());
+
+   StateHeader hdr;
+   if (data.size() < sizeof(hdr)) {
+      throw runtime_error(fname + ": not a solver state");
+   }
+   memcpy(&hdr, data.data(), sizeof(hdr));
+   const size_t popBytes = size_t(hdr.populationSize)*(sizeof(FitnessEntry) + hdr.chromosomeLength*sizeof(double));
+   if (memcmp(hdr.magic, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0 || hdr.byteOrder != STATE_BYTE_ORDER ||
+         hdr.version != STATE_VERSION) {
+      throw runtime_error(fname + ": not a solver state, or written by an incompatible version");
+   }
+   const size_t routeBytes = size_t(hdr.numOffsets)*sizeof(int32_t) + size_t(hdr.numVisits)*sizeof(RouteVisit);
+   const size_t searchedBytes = size_t(hdr.numSearched)*hdr.chromosomeLength*sizeof(double);
+   if (data.size() != sizeof(hdr) + hdr.rngLength + hdr.numPopulations*popBytes + routeBytes + searchedBytes) {
+      throw runtime_error(fname + ": solver state is truncated");
+   }
+
+   SolverState state;
+   state.seed = hdr.seed;
+   state.chromosomeLength = hdr.chromosomeLength;
+   state.generation = hdr.generation;
+   state.noImprove = hdr.noImprove;
+   state.opIpr = hdr.opIpr;
+   state.opXe = hdr.opXe;
+   state.opRst = hdr.opRst;
+   state.iprHomogeneous = hdr.iprHomogeneous;
+   state.iprNoImprovement = hdr.iprNoImprovement;
+   state.iprEliteImprovement = hdr.iprEliteImprovement;
+   state.iprBestImprovement = hdr.iprBestImprovement;
+   state.evaluations = hdr.evaluations;
+   state.evalsToBest = hdr.evalsToBest;
+   state.timeToBest = hdr.timeToBest;
+   state.elapsed = hdr.elapsed;
+   state.localBest = hdr.localBest;
+   state.overallBest = hdr.overallBest;
+   state.dist = hdr.dist;
+   state.tard = hdr.tard;
+   state.tmax = hdr.tmax;
+   state.bestFitness = hdr.bestFitness;
+   state.opLs = hdr.opLs;
+   state.lsInjected = hdr.lsInjected;
+   state.lsSeconds = hdr.lsSeconds;
+
+   const char *pos = data.data() + sizeof(hdr);
+   state.rngState.assign(pos, hdr.rngLength);
+   pos += hdr.rngLength;
+
+   state.populations.resize(hdr.numPopulations);
+   for (auto &pop: state.populations) {
+      pop.fitness.resize(hdr.populationSize);
+      for (auto &f: pop.fitness) {
+         FitnessEntry entry;
+         memcpy(&entry, pos, sizeof(entry));
+         pos += sizeof(entry);
+         if (entry.index >= hdr.populationSize) {
+            throw runtime_error(fname + ": solver state has an invalid fitness index");
+         }
+         f = make_pair(entry.value, entry.index);
+      }
+      pop.chromosomes.assign(hdr.populationSize, vector<double>(hdr.chromosomeLength));
+      for (auto &chromosome: pop.chromosomes) {
+         memcpy(chromosome.data(), pos, hdr.chromosomeLength*sizeof(double));
+         pos += hdr.chromosomeLength*sizeof(double);
+      }
+   }
+
+   auto &routes = state.bestRoutes;
+   routes.offsets.resize(hdr.numOffsets);
+   memcpy(routes.offsets.data(), pos, hdr.numOffsets*sizeof(int32_t));
+   pos += hdr.numOffsets*sizeof(int32_t);
+   routes.visits.resize(hdr.numVisits);
+   memcpy(routes.visits.data(), pos, hdr.numVisits*sizeof(RouteVisit));
+   pos += hdr.numVisits*sizeof(RouteVisit);
+   if (!routes.offsets.empty() && (routes.offsets.front() != 0 || routes.offsets.back() != int(hdr.numVisits) ||
+         !is_sorted(routes.offsets.begin(), routes.offsets.end()))) {
+      throw runtime_error(fname + ": solver state has invalid routes");
+   }
+
+   state.searched.assign(hdr.numSearched, vector<double>(hdr.chromosomeLength));
+   for (auto &chromosome: state.searched) {
+      memcpy(chromosome.data(), pos, hdr.chromosomeLength*sizeof(double));
+      pos += hdr.chromosomeLength*sizeof(double);
+   }
+
+   return state;
+}
@@ -0,0 +1,152 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include "Solution.h"
+
+#include "brkga_mp_ipr.hpp"
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Snapshot of a run between two generations, from which it can be resumed.
+ * It holds the populations and the PRNG state of the genetic algorithm, and
+ * the indicators of the search loop. Restoring it makes the resumed run follow
+ * the same trajectory as the interrupted one.
+ */
+struct SolverState {
+   /// Individuals of a population and their fitness, as kept by the library.
+   struct Population {
+      std::vector <std::vector<double>> chromosomes;
+      std::vector <std::pair<double, unsigned>> fitness;
+   };
+
+   int32_t seed = 0;
+   uint32_t chromosomeLength = 0;
+
+   // Search loop.
+   uint32_t generation = 0;
+   int32_t noImprove = 0;
+   double localBest = 0.0;
+   double overallBest = 0.0;
+   double dist = 0.0;
+   double tard = 0.0;
+   double tmax = 0.0;
+
+   // Fitness of the chromosome decoded into the best solution, and the
+   // routes of that solution.
+   double bestFitness = 0.0;
+   RouteArena bestRoutes;
+
+   // Local search during the run: its applications, the chromosomes it
+   // injected, its time, and the chromosomes searched in the last one.
+   int32_t opLs = 0;
+   int32_t lsInjected = 0;
+   double lsSeconds = 0.0;
+   std::vector <std::vector<double>> searched;
+
+   int32_t opIpr = 0;
+   int32_t opXe = 0;
+   int32_t opRst = 0;
+   int32_t iprHomogeneous = 0;
+   int32_t iprNoImprovement = 0;
+   int32_t iprEliteImprovement = 0;
+   int32_t iprBestImprovement = 0;
+
+   // Chromosomes evaluated before the snapshot, and when the best solution
+   // was found. Times are in seconds since the start of the run.
+   uint64_t evaluations = 0;
+   uint64_t evalsToBest = 0;
+   double timeToBest = 0.0;
+   double elapsed = 0.0;
+
+   /// State of the PRNG of the algorithm, in the text format of the standard library.
+   std::string rngState;
+   std::vector <Population> populations;
+
+   /// Writes the state to a temporary file renamed to `fname`, so an
+   /// interruption never leaves a partial state behind. Throws
+   /// `std::runtime_error` if it cannot be written.
+   void write(const std::string &fname) const;
+
+   /// Throws `std::runtime_error` if the file is not a solver state.
+   static SolverState read(const std::string &fname);
+};
+
+/**
+ * BRKGA-MP-IPR whose populations and PRNG may be saved and restored. The
+ * library keeps them in protected members, without accessors to replace them.
+ */
+template <class Decoder>
+class ResumableBrkga: public BRKGA::BRKGA_MP_IPR<Decoder> {
+public:
+   using BRKGA::BRKGA_MP_IPR<Decoder>::BRKGA_MP_IPR;
+
+   /// Copies the populations and the PRNG state into `state`.
+   void saveState(SolverState &state) const {
+      state.chromosomeLength = this->CHROMOSOME_SIZE;
+      state.populations.resize(this->current.size());
+      for (size_t k = 0; k < this->current.size(); ++k) {
+         state.populations[k].chromosomes = this->current[k]->population;
+         state.populations[k].fitness = this->current[k]->fitness;
+      }
+      std::ostringstream text;
+      text << this->rng;
+      state.rngState = text.str();
+   }
+
+   /// Replaces the populations and the PRNG state of an initialized algorithm.
+   /// Throws `std::runtime_error` if their sizes do not match its parameters.
+   void restoreState(const SolverState &state) {
+      if (state.chromosomeLength != this->CHROMOSOME_SIZE ||
+            state.populations.size() != this->current.size()) {
+         throw std::runtime_error("solver state has a different chromosome length or number of populations");
+      }
+      for (size_t k = 0; k < this->current.size(); ++k) {
+         if (state.populations[k].chromosomes.size() != this->current[k]->population.size()) {
+            throw std::runtime_error("solver state has a different population size");
+         }
+      }
+      std::istringstream text(state.rngState);
+      text >> this->rng;
+      if (!text) {
+         throw std::runtime_error("solver state has an invalid PRNG state");
+      }
+      for (size_t k = 0; k < this->current.size(); ++k) {
+         this->current[k]->population = state.populations[k].chromosomes;
+         this->current[k]->fitness = state.populations[k].fitness;
+      }
+   }
+};
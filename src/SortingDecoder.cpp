@@ -27,19 +27,79 @@
  */
 
 #include "SortingDecoder.h"
+#include "Profiler.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <iostream>
-#include <numeric>
+#include <limits>
+
+#include <omp.h>
 
 using namespace std;
 
-SortingDecoder::SortingDecoder(const Instance& inst_): inst(inst_) {
+namespace {
+
+/// Counts a decoding as running while in scope.
+class ActiveDecode {
+public:
+   explicit ActiveDecode(atomic<int> &count): m_count(count) {
+      m_count.fetch_add(1, memory_order_relaxed);
+   }
+
+   ~ActiveDecode() {
+      m_count.fetch_sub(1, memory_order_relaxed);
+   }
+
+private:
+   atomic<int> &m_count;
+};
+
+}
+
+DecoderWorkspace::DecoderWorkspace(const Instance &inst): state(inst) {
+   sorter.reserve(inst.numNodes()-2);
+   wtime.resize(inst.numVehicles());
+   allowed.resize(inst.numVehicles());
+
+   size_t maxPairs = 0;
+   for (int i = 1; i < inst.numNodes()-1; ++i)
+      maxPairs = max(maxPairs, inst.nodeVehiclePairs(i).size());
+
+   candVehi.resize(inst.numVehicles());
+   candPairs.resize(maxPairs);
+   candRank.resize(maxPairs);
+   bound0.reserve(inst.numVehicles());
+   bound1.reserve(inst.numVehicles());
+   mark.resize(inst.numVehicles());
+   candDist.resize(inst.numVehicles());
+   candLeave.resize(inst.numVehicles());
+   candDepot.resize(inst.numVehicles());
+   vehiArrival.resize(inst.numVehicles());
+   vehiDist.resize(inst.numVehicles());
+   vehiDepot.resize(inst.numVehicles());
+   cost.resize(max(maxPairs, static_cast<size_t>(inst.numVehicles())));
+}
+
+SortingDecoder::SortingDecoder(const Instance& inst_, int granularity_): inst(inst_) {
+   static atomic<uint64_t> serials {0};
+   m_serial = ++serials;
+   kernels = &insertionKernels();
+
    // Pair the task lists with the chromosome keys.
    allTasks = createTaskList(inst);
-   lexOrder.resize(allTasks.size());
-   iota(lexOrder.begin(), lexOrder.end(), 0);
+
+   const int patients = inst.numNodes() - 2;
+   granularity = min(max(granularity_, 0), patients - 1);
+   if (granularity <= 0) {
+      granularity = 0;
+      return;
+   }
+
+   neighbours = inst.nearestPredecessors(granularity);
 }
 
 int SortingDecoder::chromosomeLength() const {
@@ -51,33 +111,205 @@ int SortingDecoder::chromosomeLength() const {
    return (inst.numNodes()-2) + 1 + 1;
 }
 
-Solution SortingDecoder::decodeSolution(const std::vector<double> &chromosome) const {
-   // Solution being build.
-   Solution currSol(inst);
-   currSol.convHull = chromosome[chromosome.size()-2] >= 0.5;
-   bool enableHeur = chromosome[chromosome.size()-1] >= 0.5;
+DecoderWorkspace &SortingDecoder::workspace() const {
+   // Last workspace used by this thread, and the decoder owning it.
+   thread_local uint64_t lastSerial = 0;
+   thread_local DecoderWorkspace *last = nullptr;
+   if (lastSerial == m_serial)
+      return *last;
 
+   // Only reached when the thread alternates between decoders.
+   lock_guard<mutex> lock(m_wsMutex);
+   const auto self = this_thread::get_id();
+   last = nullptr;
+   for (auto &ws: m_workspaces) {
+      if (ws->owner == self)
+         last = ws.get();
+   }
+   if (!last) {
+      m_workspaces.emplace_back(make_unique<DecoderWorkspace>(inst));
+      last = m_workspaces.back().get();
+      last->owner = self;
+      last->next = m_wsHead.load(memory_order_relaxed);
+      m_wsHead.store(last, memory_order_release);
+   }
+   lastSerial = m_serial;
+   return *last;
+}
+
+int SortingDecoder::numWorkspaces() const {
+   lock_guard<mutex> lock(m_wsMutex);
+   return m_workspaces.size();
+}
+
+Solution SortingDecoder::decodeSolution(const std::vector<double> &chromosome) const {
    // Create the entire assignment order using random keys from chromossome.
    assert(chromosomeLength() == static_cast<int>(chromosome.size()) &&
       "Chromossome not long enough to support the sorting procedure.");
 
-   // Takes the lexOrder as template, and the sorts a copy of
-   // the indirect index vector.
-   auto taskIndices = lexOrder;
-   sort(begin(taskIndices), end(taskIndices), [&](int i, int j) {
-      return chromosome[i] < chromosome[j];
+   Solution sol(inst);
+   auto &ws = workspace();
+   construct(chromosome, ws.sorter.sort(chromosome.data(), allTasks.size(), fastSort), sol, ws);
+   return sol;
+}
+
+double SortingDecoder::decode(const std::vector<double> &chromosome, bool rewrite) const {
+   (void) rewrite;
+   assert(chromosomeLength() == static_cast<int>(chromosome.size()) &&
+      "Chromossome not long enough to support the sorting procedure.");
+
+   auto &ws = workspace();
+   ++ws.decodings;
+   const auto t0 = chrono::steady_clock::now();
+   bool cached = false;
+   const double cost = evaluate(chromosome, ws, cached);
+   const uint64_t nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+
+   // The counters of the hot path are plain fields of the workspace, which
+   // are published once per decoding.
+   auto &c = ws.counters;
+   DecoderCounters::add(c.decodings, 1);
+   DecoderCounters::add(c.cacheHits, cached ? 1 : 0);
+   DecoderCounters::add(c.nanos, nanos);
+   DecoderCounters::add(c.timeBins[DecoderTelemetry::timeBin(nanos)], 1);
+   c.pairsConsidered.store(ws.pairsConsidered, memory_order_relaxed);
+   c.pairsEvaluated.store(ws.pairsEvaluated, memory_order_relaxed);
+   c.tasksDecoded.store(ws.checkpoints.tasksDecoded, memory_order_relaxed);
+   c.tasksSkipped.store(ws.checkpoints.tasksSkipped, memory_order_relaxed);
+   return cost;
+}
+
+double SortingDecoder::evaluate(const std::vector<double> &chromosome, DecoderWorkspace &ws, bool &cached) const {
+   // Sorts the tasks by their keys. Ties, if any, are broken by the task index.
+   const auto &taskIndices = ws.sorter.sort(chromosome.data(), allTasks.size(), fastSort);
+
+   FitnessCache::Key key;
+   if (cache.enabled()) {
+      key = cacheKey(chromosome, taskIndices);
+      double fitness;
+      if (cache.find(key, fitness)) {
+         cached = true;
+         return fitness;
+      }
+   }
+
+   if (m_numeric) {
+      const double cost = m_numeric->decode(chromosome, taskIndices);
+      if (cache.enabled())
+         cache.insert(key, cost);
+      return cost;
+   }
+
+   ws.state.reset();
+   int start = 0;
+   CheckpointStore *checkpoints = nullptr;
+   if (checkpointSlots > 0) {
+      checkpoints = &ws.checkpoints;
+      if (!checkpoints->enabled())
+         checkpoints->setup(checkpointSlots, allTasks.size(), inst.numVehicles());
+      start = checkpoints->resume(taskIndices, chromosome, ws.state, ws.wtime);
+   }
+   construct(chromosome, taskIndices, ws.state, ws, start, checkpoints);
+
+   if (cache.enabled())
+      cache.insert(key, ws.state.cachedCost);
+   return ws.state.cachedCost;
+}
+
+void SortingDecoder::setNumericMode(NumericMode mode) {
+   if (mode == NUMERIC_DOUBLE)
+      m_numeric.reset();
+   else
+      m_numeric = NumericDecoder::create(mode, inst, allTasks, granularity, neighbours);
+}
+
+NumericMode SortingDecoder::numericMode() const {
+   return m_numeric ? m_numeric->mode() : NUMERIC_DOUBLE;
+}
+
+WorkStealingPool::Stats SortingDecoder::decodeBatch(Span<std::vector<double>> chromosomes, double *fitness) const {
+   lock_guard<mutex> lock(m_poolMutex);
+   if (!m_pool)
+      m_pool.reset(new WorkStealingPool(batchThreads));
+
+   return m_pool->run(chromosomes.size(), [&] (int i) {
+      fitness[i] = decode(chromosomes[i], false);
    });
+}
+
+FitnessCache::Key SortingDecoder::cacheKey(const std::vector<double> &chromosome,
+      const std::vector<int> &taskIndices) const {
+   FitnessCache::Hasher hasher;
+   const size_t n = taskIndices.size();
+
+   hasher.add((chromosome[n] >= 0.5) | (chromosome[n+1] >= 0.5) << 1);
+   for (size_t i = 0; i < n; i += 2) {
+      const uint64_t hi = i+1 < n ? taskIndices[i+1] : 0xffffffffu;
+      hasher.add(static_cast<uint32_t>(taskIndices[i]) | hi << 32);
+   }
+
+   uint64_t bits = 0;
+   for (size_t i = 0; i < n; ++i) {
+      bits |= static_cast<uint64_t>(chromosome[i] >= 0.5) << (i % 64);
+      if (i % 64 == 63 || i+1 == n) {
+         hasher.add(bits);
+         bits = 0;
+      }
+   }
+
+   return hasher.finish();
+}
+
+template <typename State>
+void SortingDecoder::construct(const std::vector<double> &chromosome, const std::vector<int> &taskIndices,
+      State &currSol, DecoderWorkspace &ws, int start, CheckpointStore *checkpoints) const {
+   const bool convHull = chromosome[chromosome.size()-2] >= 0.5;
+   const bool enableHeur = chromosome[chromosome.size()-1] >= 0.5;
+   ActiveDecode active(m_activeDecodes);
+
+   if (convHull) {
+      if (enableHeur)
+         constructAs<true, true>(chromosome, taskIndices, currSol, ws, start, checkpoints);
+      else
+         constructAs<true, false>(chromosome, taskIndices, currSol, ws, start, checkpoints);
+   } else {
+      if (enableHeur)
+         constructAs<false, true>(chromosome, taskIndices, currSol, ws, start, checkpoints);
+      else
+         constructAs<false, false>(chromosome, taskIndices, currSol, ws, start, checkpoints);
+   }
+}
+
+template <bool ConvHull, bool EnableHeur, typename State>
+void SortingDecoder::constructAs(const std::vector<double> &chromosome, const std::vector<int> &taskIndices,
+      State &currSol, DecoderWorkspace &ws, int start, CheckpointStore *checkpoints) const {
+   // `currSol` holds the solution being build, initially empty, or the
+   // partial solution with the first `start` tasks restored from a checkpoint.
+   currSol.convHull = ConvHull;
 
    // Implements an heuristic that balances the workload among vehicles.
    // This very simple implementation does not seems to make a great difference
    // in the vehicles workload, but is has a secondary function of tie-breaking
    // routes of vehicles that are much similar (regarding their qualifications).
-   vector <double> wtime(inst.numVehicles(), 0.0);
-   auto heur = [&] (Task &t) {
-      currSol.findInsertionCost(t);
-      if (enableHeur) {
-         double w = wtime[t.vehi[0]] + t.skills[1] >= 0 ? wtime[t.vehi[1]] : 0.0;
-         t.cachedCost += enableHeur*w;
+   auto &wtime = ws.wtime;
+   if (start == 0)
+      fill(wtime.begin(), wtime.end(), 0.0);
+   auto heur = [&] (Task &t, Instance::SvcType svcType) {
+      switch (svcType) {
+         case Instance::SvcType::SINGLE:
+            currSol.template insertionCost<ConvHull, Instance::SvcType::SINGLE>(t);
+            break;
+         case Instance::SvcType::SIM:
+            currSol.template insertionCost<ConvHull, Instance::SvcType::SIM>(t);
+            break;
+         default:
+            currSol.template insertionCost<ConvHull, Instance::SvcType::PRED>(t);
+            break;
+      }
+      if constexpr (EnableHeur) {
+         // Only the workload of the second vehicle is taken into account.
+         double w = t.skills[1] >= 0 ? wtime[t.vehi[1]] : 0.0;
+         t.cachedCost += w;
       }
       return t.cachedCost;
    };
@@ -89,61 +321,457 @@ Solution SortingDecoder::decodeSolution(const std::vector<double> &chromosome) c
       currSol.updateRoutes(t);
    };
 
-   for (size_t i = 0; i < taskIndices.size(); ++i) {
+   // Flags the vehicles allowed to serve the current task in granular mode.
+   auto &allowed = ws.allowed;
+
+   // Kernels for the flags of the chromosome. The one of double services is
+   // picked per task, according to its service type.
+   const SingleInsertionKernel singleKernel = kernels->single[ConvHull];
+   const PairInsertionKernel *pairKernels = kernels->pairs[ConvHull][EnableHeur];
+
+   InsertionParams params;
+   constexpr double INF = numeric_limits<double>::infinity();
+
+   const int numTasks = taskIndices.size();
+   for (int i = start; i < numTasks; ++i) {
+      if (checkpoints)
+         checkpoints->save(i, currSol, wtime);
+
       Task task = allTasks[taskIndices[i]];
       if (verbose)
        cout << "Finding best assignment to node " << task.node << "...\n";
 
-      Task best = task;
-      best.cachedCost = 1e6;
-
       assert(task.skills[0] != -1 && "First service type is unset.");
 
-      for (int v0: inst.qualifiedVehicles(task.skills[0])) {
+      const Instance::SvcType svcType = inst.nodeSvcType(task.node);
+      const bool single = svcType == Instance::SvcType::SINGLE;
+      assert((single || task.skills[1] != -1) && "Second service type is unset.");
 
-         task.vehi[0] = v0;
+      params.twMin = inst.nodeTwMin(task.node);
+      params.twMax = inst.nodeTwMax(task.node);
+      params.deltaMin = inst.nodeDeltaMin(task.node);
+      params.deltaMax = inst.nodeDeltaMax(task.node);
+      params.depotDist = inst.distance(task.node, 0);
+      params.dist = currSol.dist;
+      params.tard = currSol.tard;
+      params.tmax = currSol.tmax;
 
-         if (inst.nodeSvcType(task.node) == Instance::SvcType::SINGLE) {
-            if (heur(task) <= best.cachedCost) {
-               if (task.cachedCost < best.cachedCost) {
-                  best = task;
-               } else {
-                  if (chromosome[i] >= 0.5)
-                     best = task;
-               }
+      // Selects the candidate with the smallest cost. Among those tied, the
+      // first or the last one is taken, depending on the key of the task.
+      const bool lastOfTies = chromosome[i] >= 0.5;
+      auto select = [&] (int begin, int end, double &bestCost) {
+         int chosen = -1;
+         bestCost = INF;
+         for (int j = begin; j < end; ++j) {
+            const double c = ws.cost[j];
+            if (c < bestCost || (lastOfTies && c == bestCost)) {
+               bestCost = c;
+               chosen = j;
+            }
+         }
+         return chosen;
+      };
+
+      // Fills the costs of the candidates [0, n) with `eval(begin, end)`,
+      // and selects one of them. With a team of threads, each member
+      // evaluates and selects within a contiguous block of candidates, and
+      // the choices of the blocks are combined in order, applying the same
+      // rule, so the result does not depend on the team.
+      auto evaluate = [&] (int n, auto eval) {
+         double bestCost;
+         const int team = teamSize(n);
+         if (team < 2) {
+            eval(0, n);
+            return select(0, n, bestCost);
+         }
+
+         prepareTeam(ws, team);
+         ++ws.teamTasks;
+         int members = 1;
+         #pragma omp parallel num_threads(team)
+         {
+            const int k = omp_get_thread_num();
+            const int m = omp_get_num_threads();
+            if (k == 0)
+               members = m;
+            const int begin = static_cast<int64_t>(n) * k / m;
+            const int end = static_cast<int64_t>(n) * (k + 1) / m;
+            eval(begin, end);
+            ws.team[k].bestIndex = select(begin, end, ws.team[k].bestCost);
+         }
+
+         int chosen = -1;
+         bestCost = INF;
+         for (int k = 0; k < members; ++k) {
+            const auto &member = ws.team[k];
+            if (member.bestIndex < 0)
+               continue;
+            if (member.bestCost < bestCost || (lastOfTies && member.bestCost == bestCost)) {
+               bestCost = member.bestCost;
+               chosen = member.bestIndex;
             }
+         }
+         return chosen;
+      };
+
+      double chosenCost;
+      if (single) {
+         PROFILE_ZONE("evaluate");
+         const auto qualified = inst.nodeQualifiedVehicles(task.node, 0);
+         const int *vehi = qualified.begin();
+         int n = qualified.size();
+
+         // In granular mode, only the allowed vehicles are evaluated,
+         // unless there is none of them.
+         if (granularity > 0) {
+            int m = 0;
+            for (int v: qualified) {
+               const int pos = currSol.vehiPos[v];
+               if (pos == 0 || isNeighbour(task.node, pos))
+                  ws.candVehi[m++] = v;
+            }
+            if (m > 0) {
+               vehi = ws.candVehi.data();
+               n = m;
+            }
+         }
+
+         const int chosen = evaluate(n, [&] (int begin, int end) {
+            for (int j = begin; j < end; ++j) {
+               const int pos = currSol.vehiPos[vehi[j]];
+               ws.candDist[j] = inst.distance(pos, task.node);
+               ws.candLeave[j] = currSol.vehiLeaveTime[vehi[j]];
+               if constexpr (ConvHull)
+                  ws.candDepot[j] = inst.distance(pos, 0);
+            }
+
+            singleKernel(params, end - begin, ws.candDist.data() + begin, ws.candLeave.data() + begin,
+               ws.candDepot.data() + begin, ws.cost.data() + begin);
+         });
+         task.vehi[0] = vehi[chosen];
+         chosenCost = ws.cost[chosen];
+
+      } else {
+         PROFILE_ZONE("evaluate");
+         for (int s = 0; s < 2; ++s) {
+            for (int v: inst.nodeQualifiedVehicles(task.node, s)) {
+               const int pos = currSol.vehiPos[v];
+               const double d = inst.distance(pos, task.node);
+               ws.vehiDist[v] = d;
+               ws.vehiArrival[v] = max(params.twMin, currSol.vehiLeaveTime[v] + d);
+               if constexpr (ConvHull)
+                  ws.vehiDepot[v] = inst.distance(pos, 0);
+               if (granularity > 0)
+                  allowed[v] = pos == 0 || isNeighbour(task.node, pos);
+            }
+         }
+
+         const PairInsertionKernel pairKernel = pairKernels[svcType == Instance::SvcType::SIM];
+         const double *workload = EnableHeur ? wtime.data() : nullptr;
+         const size_t numPairs = inst.nodeVehiclePairs(task.node).size();
+         if (pruning && numPairs >= PRUNING_MIN_PAIRS) {
+            // Searches the granular neighbourhood first, if enabled, and
+            // all the pairs if it has none.
+            const int team = teamSize(numPairs);
+            if (granularity == 0 ||
+                  !searchPairs<ConvHull>(params, pairKernel, task, lastOfTies, true, workload, ws, chosenCost, team))
+               searchPairs<ConvHull>(params, pairKernel, task, lastOfTies, false, workload, ws, chosenCost, team);
 
          } else {
-            assert(task.skills[1] != -1 && "Second service type is unset.");
-            for (int v1: inst.qualifiedVehicles(task.skills[1])) {
-               if (v0 == v1)
-                  continue;
-
-               task.vehi[1] = v1;
-
-               if (heur(task) <= best.cachedCost) {
-                  if (task.cachedCost < best.cachedCost) {
-                     best = task;
-                  } else {
-                     if (chromosome[i] >= 0.5)
-                        best = task;
-                  }
+            // Pairs are enumerated in the same order of the nested loops
+            // over qualified vehicles, thus preserving the tie-breaking.
+            const auto qualified = inst.nodeVehiclePairs(task.node);
+            const Instance::VehiclePair *pairs = qualified.begin();
+            int n = qualified.size();
+
+            if (granularity > 0) {
+               int m = 0;
+               for (auto vp: qualified) {
+                  if (allowed[vp.v0] && allowed[vp.v1])
+                     ws.candPairs[m++] = vp;
+               }
+               if (m > 0) {
+                  pairs = ws.candPairs.data();
+                  n = m;
                }
             }
+
+            const int chosen = evaluate(n, [&] (int begin, int end) {
+               pairKernel(params, end - begin, pairs + begin, ws.vehiArrival.data(), ws.vehiDist.data(),
+                  ws.vehiDepot.data(), workload, ws.cost.data() + begin);
+            });
+            task.vehi[0] = pairs[chosen].v0;
+            task.vehi[1] = pairs[chosen].v1;
+            chosenCost = ws.cost[chosen];
+
+            ws.pairsConsidered += n;
+            ws.pairsEvaluated += n;
          }
       }
 
+      // Computes the remaining attributes of the chosen assignment.
+      heur(task, svcType);
+      assert(task.cachedCost == chosenCost && "Insertion kernel disagrees with the decoder.");
+
       // Update the current solution.
-      accept(best);
+      accept(task);
+   }
+
+   if (checkpoints) {
+      checkpoints->save(numTasks, currSol, wtime);
+      checkpoints->finish(numTasks);
    }
 
    // Return nodes to depot.
    currSol.finishRoutes();
+}
+
+
+template <bool ConvHull>
+bool SortingDecoder::searchPairs(const InsertionParams &params, PairInsertionKernel kernel, Task &task, bool lastOfTies,
+      bool restricted, const double *workload, DecoderWorkspace &ws, double &chosenCost, int team) const {
+   constexpr double INF = numeric_limits<double>::infinity();
+   const double *C = DecodeState::COEFS;
+   const auto q0 = inst.nodeQualifiedVehicles(task.node, 0);
+   const auto q1 = inst.nodeQualifiedVehicles(task.node, 1);
+
+   // Sorts the vehicles of each role by a lower bound on their contribution
+   // to the cost of a pair: their share of the incremental distance, their
+   // tardiness if the service started upon arrival and, for the second
+   // vehicle, its workload. `magnitude` bounds the values involved in the
+   // cost computation, to account for rounding errors.
+   double magnitude = 0.0;
+   auto sortByBound = [&] (Span<int> q, const double *w, vector<pair<double,int>> &out) {
+      out.clear();
+      for (int k = 0; k < static_cast<int>(q.size()); ++k) {
+         const int v = q[k];
+         if (restricted && !ws.allowed[v])
+            continue;
+         const double depot = ConvHull ? ws.vehiDepot[v] : 0.0;
+         const double tardiness = max(0.0, ws.vehiArrival[v] - params.twMax);
+         const double extra = w ? w[v] : 0.0;
+         out.emplace_back(C[0]*(ws.vehiDist[v] - depot) + C[1]*tardiness + extra, k);
+         magnitude = max(magnitude, C[0]*(ws.vehiDist[v] + depot) + C[1]*tardiness + extra);
+      }
+      sort(out.begin(), out.end());
+   };
+   sortByBound(q0, nullptr, ws.bound0);
+   sortByBound(q1, workload, ws.bound1);
+   if (ws.bound0.empty() || ws.bound1.empty())
+      return false;
+
+   // Counts the pairs of distinct vehicles among the candidates.
+   int shared = 0;
+   for (auto [b, k]: ws.bound0)
+      ws.mark[q0[k]] = 1;
+   for (auto [b, k]: ws.bound1)
+      shared += ws.mark[q1[k]];
+   for (auto [b, k]: ws.bound0)
+      ws.mark[q0[k]] = 0;
+   const int64_t considered = static_cast<int64_t>(ws.bound0.size())*ws.bound1.size() - shared;
+   if (considered == 0)
+      return false;
+   ws.pairsConsidered += considered;
+
+   // Terms of the cost that do not depend on the pair.
+   const double base =
+      C[0] * (params.dist + (ConvHull ? params.depotDist + params.depotDist : 0.0)) +
+      C[1] * params.tard +
+      C[2] * params.tmax;
+   magnitude += 1.0 + abs(base) + C[0]*params.depotDist*2;
+
+   // A pair is pruned only if its bound exceeds the best cost by far more
+   // than the rounding errors, so that pairs tied with the best one are
+   // always evaluated.
+   const double margin = 1e-9 * magnitude;
+
+   // Rank of a pair in the list of `nodeVehiclePairs`, used to break ties
+   // exactly as the exhaustive evaluation does.
+   const int64_t width = q1.size();
+
+   // Best cost found by any member of the team. Members prune with it as
+   // soon as it is published, but pairs tied with the final best one are
+   // never pruned, so the choice does not depend on the order of the
+   // evaluations.
+   atomic<double> sharedBest {INF};
+
+   // Searches the rows `first`, `first + step`, ..., of the sorted vehicles
+   // of the first role, using the buffers given.
+   const double minBound1 = ws.bound1.front().first;
+   auto searchRows = [&] (int first, int step, Instance::VehiclePair *candPairs,
+         int64_t *candRank, double *cost, DecoderWorkspace::TeamMember &best) {
+      best.bestCost = INF;
+      best.bestIndex = -1;
+      best.pairsEvaluated = 0;
+      const int rows = ws.bound0.size();
+      for (int r = first; r < rows; r += step) {
+         const auto [b0, k0] = ws.bound0[r];
+         const double limit = min(best.bestCost, sharedBest.load(memory_order_relaxed)) + margin;
+         if (base + b0 + minBound1 > limit)
+            break;
 
-   return currSol;
+         const int v0 = q0[k0];
+         int m = 0;
+         for (auto [b1, k1]: ws.bound1) {
+            if (base + b0 + b1 > limit)
+               break;
+            if (q1[k1] == v0)
+               continue;
+            candPairs[m] = Instance::VehiclePair{v0, q1[k1]};
+            candRank[m] = k0*width + k1;
+            ++m;
+         }
+         if (m == 0)
+            continue;
+
+         kernel(params, m, candPairs, ws.vehiArrival.data(), ws.vehiDist.data(),
+            ws.vehiDepot.data(), workload, cost);
+         best.pairsEvaluated += m;
+
+         for (int j = 0; j < m; ++j) {
+            const double c = cost[j];
+            const int64_t rank = candRank[j];
+            if (c < best.bestCost || (c == best.bestCost && (lastOfTies ? rank > best.bestIndex : rank < best.bestIndex))) {
+               best.bestCost = c;
+               best.bestIndex = rank;
+               best.bestPair = candPairs[j];
+            }
+         }
+
+         double published = sharedBest.load(memory_order_relaxed);
+         while (best.bestCost < published &&
+               !sharedBest.compare_exchange_weak(published, best.bestCost, memory_order_relaxed));
+      }
+   };
+
+   DecoderWorkspace::TeamMember result;
+   if (team < 2) {
+      searchRows(0, 1, ws.candPairs.data(), ws.candRank.data(), ws.cost.data(), result);
+      ws.pairsEvaluated += result.pairsEvaluated;
+   } else {
+      prepareTeam(ws, team);
+      ++ws.teamTasks;
+      int members = 1;
+      #pragma omp parallel num_threads(team)
+      {
+         const int k = omp_get_thread_num();
+         const int m = omp_get_num_threads();
+         if (k == 0)
+            members = m;
+         auto &member = ws.team[k];
+         searchRows(k, m, member.candPairs.data(), member.candRank.data(), member.cost.data(), member);
+      }
+
+      // Combines the choices of the members with the rule of a single search.
+      result.bestCost = INF;
+      result.bestIndex = -1;
+      for (int k = 0; k < members; ++k) {
+         const auto &member = ws.team[k];
+         ws.pairsEvaluated += member.pairsEvaluated;
+         if (member.bestIndex < 0)
+            continue;
+         if (member.bestCost < result.bestCost || (member.bestCost == result.bestCost &&
+               (lastOfTies ? member.bestIndex > result.bestIndex : member.bestIndex < result.bestIndex))) {
+            result.bestCost = member.bestCost;
+            result.bestIndex = member.bestIndex;
+            result.bestPair = member.bestPair;
+         }
+      }
+   }
+
+   task.vehi[0] = result.bestPair.v0;
+   task.vehi[1] = result.bestPair.v1;
+   chosenCost = result.bestCost;
+   return true;
 }
 
-double SortingDecoder::decode(const std::vector<double> &chromosome, bool rewrite) const {
-   (void) rewrite;
-   return decodeSolution(chromosome).cachedCost;
+void SortingDecoder::enableTeams() const {
+   const bool possible = teamThreads > 1 || (teamThreads == 0 && omp_get_num_procs() > 1);
+   if (possible && omp_get_max_active_levels() < 2)
+      omp_set_max_active_levels(2);
+}
+
+int SortingDecoder::teamSize(size_t candidates) const {
+   if (teamThreads == 1 || candidates < TEAM_MIN_CANDIDATES)
+      return 1;
+   const int threads = teamThreads > 0 ? teamThreads : omp_get_num_procs();
+   return threads / max(1, m_activeDecodes.load(memory_order_relaxed));
+}
+
+void SortingDecoder::prepareTeam(DecoderWorkspace &ws, int team) const {
+   if (static_cast<int>(ws.team.size()) >= team)
+      return;
+
+   ws.team.resize(team);
+   for (auto &member: ws.team) {
+      member.candPairs.resize(inst.numVehicles());
+      member.candRank.resize(inst.numVehicles());
+      member.cost.resize(inst.numVehicles());
+   }
+}
+
+DecoderStats SortingDecoder::stats() const {
+   DecoderStats total;
+   lock_guard<mutex> lock(m_wsMutex);
+   for (const auto &ws: m_workspaces) {
+      total.pairsConsidered += ws->pairsConsidered;
+      total.pairsEvaluated += ws->pairsEvaluated;
+      total.fullSorts += ws->sorter.fullSorts;
+      total.incrementalSorts += ws->sorter.incrementalSorts;
+      total.tasksDecoded += ws->checkpoints.tasksDecoded;
+      total.tasksSkipped += ws->checkpoints.tasksSkipped;
+      total.teamTasks += ws->teamTasks;
+      total.decodings += ws->decodings;
+   }
+   return total;
+}
+
+DecoderTelemetry SortingDecoder::telemetry() const {
+   DecoderTelemetry total;
+   for (auto ws = m_wsHead.load(memory_order_acquire); ws; ws = ws->next)
+      ws->counters.addTo(total);
+   return total;
+}
+
+void DecoderCounters::addTo(DecoderTelemetry &total) const {
+   total.decodings += decodings.load(memory_order_relaxed);
+   total.cacheHits += cacheHits.load(memory_order_relaxed);
+   total.nanos += nanos.load(memory_order_relaxed);
+   total.pairsConsidered += pairsConsidered.load(memory_order_relaxed);
+   total.pairsEvaluated += pairsEvaluated.load(memory_order_relaxed);
+   total.tasksDecoded += tasksDecoded.load(memory_order_relaxed);
+   total.tasksSkipped += tasksSkipped.load(memory_order_relaxed);
+   for (int b = 0; b < DecoderTelemetry::TIME_BINS; ++b)
+      total.timeBins[b] += timeBins[b].load(memory_order_relaxed);
+}
+
+double DecoderTelemetry::timePercentile(double q) const {
+   uint64_t count = 0;
+   for (int b = 0; b < TIME_BINS; ++b)
+      count += timeBins[b];
+   if (count == 0)
+      return 0.0;
+
+   const double rank = q*count;
+   uint64_t seen = 0;
+   for (int b = 0; b < TIME_BINS; ++b) {
+      seen += timeBins[b];
+      if (seen >= rank && timeBins[b] > 0)
+         return binMiddle(b);
+   }
+   return binMiddle(TIME_BINS-1);
+}
+
+DecoderTelemetry DecoderTelemetry::since(const DecoderTelemetry &before) const {
+   DecoderTelemetry diff = *this;
+   diff.decodings -= before.decodings;
+   diff.cacheHits -= before.cacheHits;
+   diff.nanos -= before.nanos;
+   diff.pairsConsidered -= before.pairsConsidered;
+   diff.pairsEvaluated -= before.pairsEvaluated;
+   diff.tasksDecoded -= before.tasksDecoded;
+   diff.tasksSkipped -= before.tasksSkipped;
+   for (int b = 0; b < TIME_BINS; ++b)
+      diff.timeBins[b] -= before.timeBins[b];
+   return diff;
 }
@@ -28,23 +28,322 @@
 
 #pragma once
 
+#include "CheckpointStore.h"
+#include "FitnessCache.h"
 #include "Instance.h"
+#include "InsertionKernels.h"
+#include "KeySorter.h"
+#include "NumericDecoder.h"
 #include "Solution.h"
+#include "Span.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Counters of the decodings of the population, summed over threads or
+/// taken from those of a single thread. The decoding times are counted in a
+/// histogram of 4 bins per power of two nanoseconds.
+struct DecoderTelemetry {
+   static constexpr int TIME_BINS = 160;
+
+   uint64_t decodings {0};
+   uint64_t cacheHits {0};
+   uint64_t nanos {0};
+   uint64_t pairsConsidered {0};
+   uint64_t pairsEvaluated {0};
+   uint64_t tasksDecoded {0};
+   uint64_t tasksSkipped {0};
+   uint64_t timeBins[TIME_BINS] {};
+
+   static int timeBin(uint64_t nanos) {
+      if (nanos < 4)
+         return nanos;
+      const int e = 63 - __builtin_clzll(nanos);
+      return std::min(4*(e-1) + int((nanos >> (e-2)) & 3), TIME_BINS-1);
+   }
+
+   /// Duration in nanoseconds at the middle of a bin.
+   static double binMiddle(int bin) {
+      if (bin < 4)
+         return bin;
+      const int e = bin/4 + 1;
+      return std::ldexp(4 + bin%4 + 0.5, e-2);
+   }
+
+   /// Decoding time of quantile `q`, at the resolution of the histogram.
+   double timePercentile(double q) const;
+
+   /// Counters accumulated since `before`.
+   DecoderTelemetry since(const DecoderTelemetry &before) const;
+};
+
+/// Telemetry counters of the decodings of a thread. They are written by that
+/// thread only, with relaxed loads and stores that compile to plain moves, and
+/// read by any other thread at any time without locks. Readers may miss the
+/// last decodings.
+struct alignas(64) DecoderCounters {
+   std::atomic <uint64_t> decodings {0};
+   std::atomic <uint64_t> cacheHits {0};
+   std::atomic <uint64_t> nanos {0};
+   std::atomic <uint64_t> pairsConsidered {0};
+   std::atomic <uint64_t> pairsEvaluated {0};
+   std::atomic <uint64_t> tasksDecoded {0};
+   std::atomic <uint64_t> tasksSkipped {0};
+   std::atomic <uint64_t> timeBins[DecoderTelemetry::TIME_BINS] {};
+
+   static void add(std::atomic <uint64_t> &counter, uint64_t value) {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+   }
+
+   void addTo(DecoderTelemetry &total) const;
+};
+
+/// Buffers used by a decoding, kept by each thread between successive
+/// calls so that decoding does not allocate memory once warmed up.
+struct DecoderWorkspace {
+   DecodeState state;
+   KeySorter sorter;
+   CheckpointStore checkpoints;
+   std::vector <double> wtime;
+   std::vector <char> allowed;
+
+   // Candidates of the task being inserted, and their inputs to the
+   // insertion kernels (indexed by candidate for single services, and by
+   // vehicle for double services).
+   std::vector <int> candVehi;
+   std::vector <Instance::VehiclePair> candPairs;
+   std::vector <int64_t> candRank;
+   AlignedVector <double> candDist, candLeave, candDepot;
+   AlignedVector <double> vehiArrival, vehiDist, vehiDepot;
+   AlignedVector <double> cost;
+
+   // Vehicles of each role of a double service, sorted by the lower bound
+   // of their contribution to the cost, and their positions in the lists of
+   // qualified vehicles.
+   std::vector <std::pair<double,int>> bound0, bound1;
+   std::vector <char> mark;
+
+   // Pairs of vehicles that the exhaustive search would evaluate, and pairs
+   // actually evaluated after pruning.
+   uint64_t pairsConsidered {0};
+   uint64_t pairsEvaluated {0};
+
+   // Best candidate found by each member of a team evaluating a task in
+   // parallel, and the buffers of each member searching vehicle pairs.
+   // Allocated on the first use of a team.
+   struct alignas(64) TeamMember {
+      double bestCost;
+      int64_t bestIndex;
+      Instance::VehiclePair bestPair;
+      uint64_t pairsEvaluated;
+      std::vector <Instance::VehiclePair> candPairs;
+      std::vector <int64_t> candRank;
+      AlignedVector <double> cost;
+   };
+   std::vector <TeamMember> team;
+
+   // Tasks whose candidates were evaluated by a team of threads.
+   uint64_t teamTasks {0};
+
+   // Chromosomes evaluated, including those found in the fitness cache.
+   uint64_t decodings {0};
+
+   // Thread that uses this workspace.
+   std::thread::id owner;
+
+   DecoderCounters counters;
+
+   // Next workspace of the decoder, in a list that is read without locks.
+   DecoderWorkspace *next {nullptr};
+
+   DecoderWorkspace(const Instance &inst);
+};
+
+/// Counters aggregated over the workspaces of all threads.
+struct DecoderStats {
+   uint64_t pairsConsidered {0};
+   uint64_t pairsEvaluated {0};
+
+   // Sorts of the keys from scratch, and by repairing the previous order.
+   uint64_t fullSorts {0};
+   uint64_t incrementalSorts {0};
+
+   // Tasks decoded, and tasks skipped by resuming from checkpoints.
+   uint64_t tasksDecoded {0};
+   uint64_t tasksSkipped {0};
+
+   // Tasks whose candidates were evaluated by a team of threads.
+   uint64_t teamTasks {0};
+
+   // Chromosomes evaluated, including those found in the fitness cache.
+   uint64_t decodings {0};
+};
 
 struct SortingDecoder {
    const Instance &inst;
 
    // Caches the task vector used into the decoding process.
    std::vector <Task> allTasks;
-   std::vector <int> lexOrder;
 
+   // Traces the assignments being searched. Only available in builds
+   // defining DECODER_VERBOSE, so that optimised builds carry no trace code.
+#ifdef DECODER_VERBOSE
    bool verbose {false};
+#else
+   static constexpr bool verbose {false};
+#endif
 
-   SortingDecoder(const Instance &inst_);
+   // Kernels evaluating the candidate assignments, selected at runtime
+   // according to the instruction sets supported by the processor.
+   const InsertionKernels *kernels;
+
+   // Prunes the vehicle pairs of double services by lower bounds on their
+   // costs. The chosen assignments are the same of the exhaustive search.
+   // Sorting the vehicles does not pay off when there are few pairs.
+   bool pruning {true};
+   static constexpr size_t PRUNING_MIN_PAIRS = 512;
+
+   // Sorts the keys with radix sort, or by repairing the order of the
+   // previous chromosome decoded by the thread. Otherwise, uses `std::sort`.
+   bool fastSort {true};
+
+   // Fitness of chromosomes decoded before, disabled unless given a capacity.
+   mutable FitnessCache cache;
+
+   // Number of recent decodings whose partial states are kept by each thread,
+   // to resume decodings sharing a prefix with them. Zero disables it.
+   int checkpointSlots {0};
+
+   // Granular mode: when `granularity` > 0, a task is only offered to vehicles
+   // that are still at the depot, or whose last visited node is among the
+   // `granularity` nearest time-window compatible predecessors of the task.
+   // Lists are stored with a fixed stride, padded with -1.
+   int granularity {0};
+   std::vector <int> neighbours;
+
+   // Threads that may evaluate the candidates of a single task, when they
+   // are at least `TEAM_MIN_CANDIDATES`. The threads are shared by the
+   // decodings running at the same time, so teams are only formed when there
+   // are fewer decodings than threads, e.g., for small populations. Zero
+   // takes one per processor, and one disables teams, which is the default
+   // as teams need `enableTeams`.
+   int teamThreads {1};
+   static constexpr size_t TEAM_MIN_CANDIDATES = 16384;
+
+   /// Teams are nested in the parallel loops decoding the population, so they
+   /// need two active levels of OpenMP parallelism. Raises the limit of the
+   /// process to two, unless teams cannot be formed with `teamThreads`, so
+   /// any other nested region of the process becomes active as well.
+   /// Without it, teams are made of a single thread.
+   void enableTeams() const;
+
+   // Threads of the pool decoding batches, counting the calling thread.
+   // Zero takes one per hardware thread. Read when the pool is created.
+   int batchThreads {0};
+
+   SortingDecoder(const Instance &inst_, int granularity_ = 0);
 
    int chromosomeLength() const;
 
+   /// Returns the workspace of the calling thread, creating it on the first call.
+   DecoderWorkspace &workspace() const;
+
+   /// Number of workspaces created so far, i.e., of threads that used the decoder.
+   int numWorkspaces() const;
+
+   /// Sums the counters of all workspaces. Not synchronized with decodings
+   /// running concurrently.
+   DecoderStats stats() const;
+
+   /// Sums the telemetry counters of all threads, without locks, so it may be
+   /// called while decodings are running.
+   DecoderTelemetry telemetry() const;
+
+   /// Tells whether node `pred` is in the granular neighbourhood of `node`.
+   bool isNeighbour(int node, int pred) const {
+      const int *list = &neighbours[static_cast<size_t>(node) * granularity];
+      for (int k = 0; k < granularity && list[k] >= 0; ++k)
+         if (list[k] == pred)
+            return true;
+      return false;
+   }
+
+   /// Builds the complete solution, used for reporting the incumbent.
    Solution decodeSolution(const std::vector <double> &chromosome) const;
 
+   /// Computes only the cost of the solution, which is the same as the one
+   /// of `decodeSolution`. Used to evaluate the population.
    double decode(const std::vector <double> &chromosome, bool rewrite) const;
+
+   /// Arithmetic of `decode`. Modes other than NUMERIC_DOUBLE convert the
+   /// instance data into tables of their type, and evaluate all candidates
+   /// of each task with it. `decodeSolution` always uses double precision.
+   void setNumericMode(NumericMode mode);
+   NumericMode numericMode() const;
+
+   /// Decodes a batch of chromosomes on a work-stealing thread pool, each
+   /// thread with its own workspace, and writes their costs into `fitness`.
+   /// Concurrent batches run one after the other.
+   WorkStealingPool::Stats decodeBatch(Span <std::vector <double>> chromosomes, double *fitness) const;
+
+private:
+   /// Cost of the solution, and whether it was found in the cache.
+   double evaluate(const std::vector <double> &chromosome, DecoderWorkspace &ws, bool &cached) const;
+
+   /// Decoding procedure, shared by the complete and cost-only variants.
+   /// Dispatches to the specialization for the flags of the chromosome.
+   template <typename State>
+   void construct(const std::vector <double> &chromosome, const std::vector <int> &taskIndices,
+      State &currSol, DecoderWorkspace &ws, int start = 0, CheckpointStore *checkpoints = nullptr) const;
+
+   template <bool ConvHull, bool EnableHeur, typename State>
+   void constructAs(const std::vector <double> &chromosome, const std::vector <int> &taskIndices,
+      State &currSol, DecoderWorkspace &ws, int start, CheckpointStore *checkpoints) const;
+
+   /// Hash of what the decoding depends on: the order of the tasks, the
+   /// keys of the tie-breaking rule (above or below 0.5), and the flags.
+   FitnessCache::Key cacheKey(const std::vector <double> &chromosome, const std::vector <int> &taskIndices) const;
+
+   /// Best-first search of the vehicle pair of a double service, skipping
+   /// pairs whose cost bound exceeds the best cost found. Sets the vehicles
+   /// of `task` and returns true unless there is no pair to evaluate, e.g.,
+   /// when `restricted` limits the search to the granular neighbourhood.
+   /// The search is split among the members of a team if `team` > 1.
+   template <bool ConvHull>
+   bool searchPairs(const InsertionParams &params, PairInsertionKernel kernel, Task &task, bool lastOfTies,
+      bool restricted, const double *workload, DecoderWorkspace &ws, double &chosenCost, int team) const;
+
+   /// Number of threads to evaluate this many candidates of a task.
+   int teamSize(size_t candidates) const;
+
+   /// Makes sure that the workspace has the buffers of a team this large.
+   void prepareTeam(DecoderWorkspace &ws, int team) const;
+
+   // Identifies this decoder among all instances ever created, so that the
+   // workspace cached by a thread is never taken from a destroyed decoder.
+   uint64_t m_serial;
+
+   mutable std::mutex m_wsMutex;
+   mutable std::vector <std::unique_ptr<DecoderWorkspace>> m_workspaces;
+
+   // Last workspace created, heading the list linked by their `next` fields.
+   // Workspaces are only prepended, so the list is traversed without locks.
+   mutable std::atomic <DecoderWorkspace*> m_wsHead {nullptr};
+
+   // Decoder of the reduced-precision modes, null in double precision.
+   std::unique_ptr <NumericDecoder> m_numeric;
+
+   // Decodings running at the moment, which share the threads of teams.
+   mutable std::atomic <int> m_activeDecodes {0};
+
+   // Pool of `decodeBatch`, created on its first call.
+   mutable std::mutex m_poolMutex;
+   mutable std::unique_ptr <WorkStealingPool> m_pool;
 };
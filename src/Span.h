@@ -0,0 +1,70 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+/*
+ * Read-only view over a contiguous range of elements, as a replacement of
+ * C++20 `std::span`. Spans do not own the elements, so they are valid only
+ * while the underlying storage is alive and not reallocated.
+ */
+template <typename T>
+struct Span {
+   const T *first {nullptr};
+   const T *last {nullptr};
+
+   Span() = default;
+   Span(const T *first_, const T *last_): first(first_), last(last_) {
+      // Empty by design.
+   }
+
+   const T *begin() const {
+      return first;
+   }
+
+   const T *end() const {
+      return last;
+   }
+
+   std::size_t size() const {
+      return last - first;
+   }
+
+   bool empty() const {
+      return first == last;
+   }
+
+   const T &operator[](std::size_t idx) const {
+      assert(first + idx < last && "Span index out of range.");
+      return first[idx];
+   }
+};
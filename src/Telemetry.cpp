@@ -0,0 +1,124 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "Telemetry.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char *FIELDS[] = {
+   "generation", "time", "generation_time", "evaluations", "evals_per_sec",
+   "decodings", "decode_mean_us", "decode_p50_us", "decode_p90_us", "decode_p99_us",
+   "cache_hits", "pairs_considered", "pairs_evaluated", "tasks_decoded", "tasks_resumed",
+   "local_best", "best", "elite_mean", "elite_stdev", "no_improve",
+   "events", "pr_result", "pr_time"
+};
+
+/// Writes a number, or null (empty in CSV) when not finite, e.g., the local
+/// best right after a reset.
+void writeNumber(ostream &out, double value, Telemetry::Format format) {
+   if (isfinite(value))
+      out << value;
+   else if (format == Telemetry::JSONL)
+      out << "null";
+}
+
+}
+
+Telemetry::Telemetry(const string &fname, Format format):
+   m_file(fname, ios::trunc), m_format(format) {
+
+   if (!m_file) {
+      throw runtime_error(fname + ": telemetry file could not be created");
+   }
+   m_file.precision(10);
+   if (m_format == CSV) {
+      const char *sep = "";
+      for (const char *field: FIELDS) {
+         m_file << sep << field;
+         sep = ",";
+      }
+      m_file << "\n";
+   }
+}
+
+void Telemetry::write(const Record &rec) {
+   const auto &dec = rec.decoder;
+   const double values[] = {
+      double(rec.generation), rec.elapsed, rec.generationTime, double(rec.evaluations),
+      rec.generationTime > 0.0 ? dec.decodings/rec.generationTime : 0.0,
+      double(dec.decodings), dec.decodings > 0 ? dec.nanos/1e3/dec.decodings : 0.0,
+      dec.timePercentile(0.50)/1e3, dec.timePercentile(0.90)/1e3, dec.timePercentile(0.99)/1e3,
+      double(dec.cacheHits), double(dec.pairsConsidered), double(dec.pairsEvaluated),
+      double(dec.tasksDecoded), double(dec.tasksSkipped),
+      rec.localBest, rec.overallBest, rec.eliteMean, rec.eliteStdev, double(rec.noImprove)
+   };
+   const string texts[] = {rec.events, rec.prResult};
+   constexpr size_t numValues = sizeof(values)/sizeof(values[0]);
+   static_assert(numValues + 2 + 1 == sizeof(FIELDS)/sizeof(FIELDS[0]), "Fields and values differ.");
+
+   // Events and results are made of letters and spaces only, never escaped.
+   if (m_format == JSONL) {
+      m_file << "{";
+      for (size_t k = 0; k < numValues; ++k) {
+         m_file << (k > 0 ? "," : "") << '"' << FIELDS[k] << "\":";
+         writeNumber(m_file, values[k], m_format);
+      }
+      for (size_t k = 0; k < 2; ++k)
+         m_file << ",\"" << FIELDS[numValues + k] << "\":\"" << texts[k] << '"';
+      m_file << ",\"" << FIELDS[numValues + 2] << "\":";
+      writeNumber(m_file, rec.prTime, m_format);
+      m_file << "}\n";
+   } else {
+      for (size_t k = 0; k < numValues; ++k) {
+         m_file << (k > 0 ? "," : "");
+         writeNumber(m_file, values[k], m_format);
+      }
+      m_file << "," << texts[0] << "," << texts[1] << ",";
+      writeNumber(m_file, rec.prTime, m_format);
+      m_file << "\n";
+   }
+   m_file.flush();
+}
+
+Telemetry::Format Telemetry::formatFromName(const string &name) {
+   for (auto format: {JSONL, CSV}) {
+      if (name == formatName(format))
+         return format;
+   }
+   throw runtime_error("unknown telemetry format: " + name);
+}
+
+const char *Telemetry::formatName(Format format) {
+   return format == JSONL ? "jsonl" : "csv";
+}
@@ -0,0 +1,85 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include "SortingDecoder.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * Stream of one record per generation, written as JSON lines or as CSV with
+ * a header line. The decoding times and the counters of the decoder refer to
+ * the generation, the evaluations to the whole run.
+ */
+class Telemetry {
+public:
+   enum Format {
+      JSONL,
+      CSV
+   };
+
+   struct Record {
+      unsigned generation;
+
+      // Seconds since the start of the program, and spent in this generation.
+      double elapsed;
+      double generationTime;
+
+      uint64_t evaluations;
+      DecoderTelemetry decoder;
+
+      double localBest;
+      double overallBest;
+      double eliteMean;
+      double eliteStdev;
+      int noImprove;
+
+      // Operators applied after evolving the population (P, X, L and R, as in the
+      // progress table), the result of path relinking and its duration.
+      std::string events;
+      std::string prResult;
+      double prTime;
+   };
+
+   /// Creates the file, replacing any file with the same name. Throws
+   /// `std::runtime_error` if it cannot be created.
+   Telemetry(const std::string &fname, Format format);
+
+   void write(const Record &rec);
+
+   static Format formatFromName(const std::string &name);
+   static const char *formatName(Format format);
+
+private:
+   std::ofstream m_file;
+   Format m_format;
+};
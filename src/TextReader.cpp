@@ -0,0 +1,258 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "TextReader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <lzma.h>
+#include <zlib.h>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 1 << 20;
+
+const unsigned char XZ_MAGIC[] = {0xFD, '7', 'z', 'X', 'Z', 0x00};
+const unsigned char GZ_MAGIC[] = {0x1F, 0x8B};
+
+bool hasMagic(const void *data, size_t size, const unsigned char *magic, size_t len) {
+   return size >= len && memcmp(data, magic, len) == 0;
+}
+
+// Reads the next chunk of compressed data. Returns false at end of file.
+bool readChunk(int fd, vector<unsigned char> &chunk, size_t &len, const string &fname) {
+   ssize_t ret;
+   do {
+      ret = read(fd, chunk.data(), chunk.size());
+   } while (ret == -1 && errno == EINTR);
+   if (ret == -1)
+      throw runtime_error(fname + ": read error: " + strerror(errno));
+   len = ret;
+   return ret > 0;
+}
+
+// Appends decompressed data to the output buffer, growing it as needed.
+template <typename Stream>
+void growOutput(Stream &strm, vector<char> &out, size_t &used) {
+   used = out.size() - strm.avail_out;
+   if (strm.avail_out == 0) {
+      out.resize(out.size()*2);
+   }
+   strm.next_out = reinterpret_cast<decltype(strm.next_out)>(out.data() + used);
+   strm.avail_out = out.size() - used;
+}
+
+vector<char> decompressXz(int fd, const string &fname) {
+   lzma_stream strm = LZMA_STREAM_INIT;
+   if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+      throw runtime_error(fname + ": could not initialize the xz decoder");
+
+   vector<unsigned char> chunk(CHUNK_SIZE);
+   vector<char> out(4*CHUNK_SIZE);
+   size_t used = 0, len = 0;
+   strm.next_out = reinterpret_cast<uint8_t*>(out.data());
+   strm.avail_out = out.size();
+
+   lzma_action action = LZMA_RUN;
+   while (true) {
+      if (strm.avail_in == 0 && action == LZMA_RUN) {
+         if (!readChunk(fd, chunk, len, fname))
+            action = LZMA_FINISH;
+         strm.next_in = chunk.data();
+         strm.avail_in = len;
+      }
+      lzma_ret ret = lzma_code(&strm, action);
+      growOutput(strm, out, used);
+      if (ret == LZMA_STREAM_END)
+         break;
+      if (ret != LZMA_OK) {
+         lzma_end(&strm);
+         throw runtime_error(fname + ": corrupted xz stream (liblzma error " + to_string(ret) + ")");
+      }
+   }
+   lzma_end(&strm);
+   out.resize(used);
+   return out;
+}
+
+vector<char> decompressGz(int fd, const string &fname) {
+   z_stream strm;
+   memset(&strm, 0, sizeof(strm));
+   // Adding 32 to window bits enables the gzip header detection.
+   if (inflateInit2(&strm, 32 + MAX_WBITS) != Z_OK)
+      throw runtime_error(fname + ": could not initialize the gzip decoder");
+
+   vector<unsigned char> chunk(CHUNK_SIZE);
+   vector<char> out(4*CHUNK_SIZE);
+   size_t used = 0, len = 0;
+   strm.next_out = reinterpret_cast<Bytef*>(out.data());
+   strm.avail_out = out.size();
+
+   bool finished = false;
+   while (!finished) {
+      if (strm.avail_in == 0) {
+         if (!readChunk(fd, chunk, len, fname)) {
+            inflateEnd(&strm);
+            throw runtime_error(fname + ": truncated gzip stream");
+         }
+         strm.next_in = chunk.data();
+         strm.avail_in = len;
+      }
+      int ret = inflate(&strm, Z_NO_FLUSH);
+      growOutput(strm, out, used);
+      if (ret == Z_STREAM_END) {
+         // Concatenated gzip members are decoded as a single text.
+         if (strm.avail_in > 0 || readChunk(fd, chunk, len, fname)) {
+            if (strm.avail_in == 0) {
+               strm.next_in = chunk.data();
+               strm.avail_in = len;
+            }
+            inflateReset(&strm);
+         } else {
+            finished = true;
+         }
+      } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+         inflateEnd(&strm);
+         throw runtime_error(fname + ": corrupted gzip stream (zlib error " + to_string(ret) + ")");
+      }
+   }
+   inflateEnd(&strm);
+   out.resize(used);
+   return out;
+}
+
+} // namespace
+
+TextReader::TextReader(const char *fname): m_fname(fname), m_data(nullptr), m_size(0), m_pos(0), m_line(1) {
+   int fd = open(fname, O_RDONLY);
+   struct stat st;
+   if (fd == -1 || fstat(fd, &st) == -1) {
+      const string err = strerror(errno);
+      if (fd != -1)
+         close(fd);
+      throw runtime_error(m_fname + ": could not be read: " + err);
+   }
+
+   const size_t len = st.st_size;
+   void *addr = len > 0 ? mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+   if (addr == MAP_FAILED) {
+      close(fd);
+      throw runtime_error(m_fname + ": could not be mapped into memory");
+   }
+
+   if (hasMagic(addr, len, XZ_MAGIC, sizeof(XZ_MAGIC)) || hasMagic(addr, len, GZ_MAGIC, sizeof(GZ_MAGIC))) {
+      const bool isXz = hasMagic(addr, len, XZ_MAGIC, sizeof(XZ_MAGIC));
+      munmap(addr, len);
+      try {
+         auto buf = make_shared<vector<char>>(isXz ? decompressXz(fd, m_fname) : decompressGz(fd, m_fname));
+         m_data = buf->data();
+         m_size = buf->size();
+         m_block = buf;
+      } catch (...) {
+         close(fd);
+         throw;
+      }
+   } else if (addr != nullptr) {
+      madvise(addr, len, MADV_SEQUENTIAL);
+      m_data = static_cast<const char*>(addr);
+      m_size = len;
+      m_block = shared_ptr<const void>(addr, [len] (const void *ptr) {
+         munmap(const_cast<void*>(ptr), len);
+      });
+   }
+   close(fd);
+}
+
+bool TextReader::eof() const {
+   return m_pos >= m_size;
+}
+
+int TextReader::lineNumber() const {
+   return m_line;
+}
+
+void TextReader::setSection(const std::string &name) {
+   m_section = name;
+}
+
+TextReader::Mark TextReader::mark() const {
+   return Mark{m_pos, m_line};
+}
+
+void TextReader::reset(const Mark &mk) {
+   m_pos = mk.pos;
+   m_line = mk.line;
+}
+
+std::string_view TextReader::nextLine(int *line) {
+   if (line)
+      *line = m_line;
+
+   const char *first = m_data + m_pos;
+   const char *nl = static_cast<const char*>(memchr(first, '\n', m_size - m_pos));
+   size_t len = nl ? nl - first : m_size - m_pos;
+   m_pos += nl ? len + 1 : len;
+   ++m_line;
+
+   if (len > 0 && first[len-1] == '\r')
+      --len;
+   return std::string_view(first, len);
+}
+
+void TextReader::finishLine() {
+   while (m_pos < m_size && isBlank(m_data[m_pos]))
+      ++m_pos;
+   if (m_pos < m_size) {
+      if (m_data[m_pos] != '\n')
+         fail("unexpected content after the last value of the section");
+      ++m_pos;
+      ++m_line;
+   }
+}
+
+void TextReader::fail(const std::string &msg) const {
+   fail(m_line, msg);
+}
+
+void TextReader::fail(int line, const std::string &msg) const {
+   string what = m_fname + ":" + to_string(line) + ": ";
+   if (!m_section.empty())
+      what += "section '" + m_section + "': ";
+   throw runtime_error(what + msg);
+}
@@ -0,0 +1,167 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+ * Read-only view of the contents of a text file, along with a minimal
+ * tokenizer that keeps track of line numbers to produce precise error
+ * messages.
+ *
+ * Plain files are mapped into memory. Files compressed with xz or gzip
+ * (detected by their magic bytes) are decompressed as a stream into an
+ * in-memory buffer.
+ *
+ * All errors are reported by throwing `std::runtime_error`, with messages
+ * in the format "<file>:<line>: section '<name>': <description>".
+ */
+class TextReader {
+public:
+   /// Position within the text, used to backtrack the tokenizer.
+   struct Mark {
+      std::size_t pos;
+      int line;
+   };
+
+   TextReader(const char *fname);
+
+   bool eof() const;
+
+   /// Line number of the next character to be read.
+   int lineNumber() const;
+
+   /// Name of the section being read, used in error messages.
+   void setSection(const std::string &name);
+
+   Mark mark() const;
+   void reset(const Mark &mk);
+
+   /**
+    * Returns the next line without its terminator, and advances to the
+    * following one. `line` receives the number of the line returned.
+    */
+   std::string_view nextLine(int *line = nullptr);
+
+   /**
+    * Returns the next number of the text, possibly skipping any whitespace
+    * including line breaks. `what` describes the value for error messages.
+    */
+   template <typename T>
+   T next(const char *what);
+
+   /// Ensures the rest of the current line is blank, and skips past it.
+   void finishLine();
+
+   [[noreturn]] void fail(const std::string &msg) const;
+   [[noreturn]] void fail(int line, const std::string &msg) const;
+
+   /**
+    * Parses exactly `count` numbers from a single line. Returns the number
+    * of values read before finding an error, `count` on success, or
+    * `count+1` if there is content after the last value.
+    */
+   template <typename T>
+   static int parseLine(std::string_view line, T *out, int count);
+
+   /// Parses a single number, accepting an optional leading plus sign.
+   template <typename T>
+   static const char *parseNumber(const char *first, const char *last, T &value);
+
+private:
+   std::string m_fname;
+   std::string m_section;
+
+   // Keeps either the file mapping or the decompressed buffer alive.
+   std::shared_ptr<const void> m_block;
+   const char *m_data;
+   std::size_t m_size;
+
+   std::size_t m_pos;
+   int m_line;
+};
+
+inline bool isBlank(char c) {
+   return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+template <typename T>
+const char *TextReader::parseNumber(const char *first, const char *last, T &value) {
+   if (first != last && *first == '+')
+      ++first;
+   auto [ptr, ec] = std::from_chars(first, last, value);
+   if (ec != std::errc() || (ptr != last && !isBlank(*ptr) && *ptr != '\n'))
+      return nullptr;
+   return ptr;
+}
+
+template <typename T>
+T TextReader::next(const char *what) {
+   while (m_pos < m_size && (isBlank(m_data[m_pos]) || m_data[m_pos] == '\n')) {
+      if (m_data[m_pos] == '\n')
+         ++m_line;
+      ++m_pos;
+   }
+   if (m_pos == m_size)
+      fail(std::string("unexpected end of file while reading ") + what);
+
+   T value;
+   const char *first = m_data + m_pos;
+   const char *ptr = parseNumber(first, m_data + m_size, value);
+   if (ptr == nullptr) {
+      std::size_t len = 0;
+      while (first + len < m_data + m_size && !isBlank(first[len]) && first[len] != '\n')
+         ++len;
+      fail("invalid value '" + std::string(first, len) + "' while reading " + what);
+   }
+   m_pos = ptr - m_data;
+   return value;
+}
+
+template <typename T>
+int TextReader::parseLine(std::string_view line, T *out, int count) {
+   const char *ptr = line.data(), *last = line.data() + line.size();
+   for (int k = 0; k < count; ++k) {
+      while (ptr < last && isBlank(*ptr))
+         ++ptr;
+      if (ptr == last)
+         return k;
+      ptr = parseNumber(ptr, last, out[k]);
+      if (ptr == nullptr)
+         return k;
+   }
+   while (ptr < last && isBlank(*ptr))
+      ++ptr;
+   return ptr == last ? count : count+1;
+}
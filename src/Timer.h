@@ -30,23 +30,24 @@
 
 #include <chrono>
 
+/// Wall-clock stopwatch, in seconds at the resolution of `steady_clock`.
+/// Phases of the algorithm are timed by the zones of Profiler.h.
 class Timer {
 public:
 
    inline void start() {
-      m_t0 = std::chrono::high_resolution_clock::now();
+      m_t0 = std::chrono::steady_clock::now();
    }
 
    inline void finish() {
-      m_t1 = std::chrono::high_resolution_clock::now();
+      m_t1 = std::chrono::steady_clock::now();
    }
 
    inline double elapsed() const {
-      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(m_t1-m_t0).count();
-      return ms/1000.0;
+      return std::chrono::duration<double>(m_t1-m_t0).count();
    }
 
 private:
-   std::chrono::high_resolution_clock::time_point m_t0, m_t1;
+   std::chrono::steady_clock::time_point m_t0, m_t1;
 };
 
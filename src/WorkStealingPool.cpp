@@ -0,0 +1,200 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+inline uint64_t pack(uint32_t begin, uint32_t end) {
+   return static_cast<uint64_t>(end) << 32 | begin;
+}
+
+inline uint32_t blockBegin(uint64_t block) {
+   return static_cast<uint32_t>(block);
+}
+
+inline uint32_t blockEnd(uint64_t block) {
+   return static_cast<uint32_t>(block >> 32);
+}
+
+inline double secondsSince(chrono::steady_clock::time_point t0) {
+   return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+}
+
+WorkStealingPool::WorkStealingPool(int threads) {
+   if (threads <= 0)
+      threads = max(1u, thread::hardware_concurrency());
+   m_numThreads = threads;
+   m_workers.reset(new Worker[threads]);
+
+   m_threads.reserve(threads - 1);
+   for (int id = 1; id < threads; ++id)
+      m_threads.emplace_back(&WorkStealingPool::loop, this, id);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+   {
+      lock_guard<mutex> lock(m_mutex);
+      m_stop = true;
+   }
+   m_wake.notify_all();
+   for (auto &t: m_threads)
+      t.join();
+}
+
+WorkStealingPool::Stats WorkStealingPool::run(int n, Body body, const void *fn) {
+   Stats stats;
+   stats.threads = m_numThreads;
+   stats.iterations = n;
+   if (n <= 0)
+      return stats;
+
+   m_iterTime.resize(n);
+   {
+      lock_guard<mutex> lock(m_mutex);
+      for (int id = 0; id < m_numThreads; ++id) {
+         auto &w = m_workers[id];
+         const uint32_t begin = static_cast<int64_t>(n) * id / m_numThreads;
+         const uint32_t end = static_cast<int64_t>(n) * (id + 1) / m_numThreads;
+         w.block.store(pack(begin, end), memory_order_relaxed);
+         w.busy = 0.0;
+         w.steals = 0;
+      }
+      m_body = body;
+      m_fn = fn;
+      m_error = nullptr;
+      m_running = m_numThreads - 1;
+      m_start = chrono::steady_clock::now();
+      ++m_generation;
+   }
+   m_wake.notify_all();
+
+   work(0);
+
+   unique_lock<mutex> lock(m_mutex);
+   m_done.wait(lock, [&] { return m_running == 0; });
+   stats.wallTime = secondsSince(m_start);
+   m_fn = nullptr;
+
+   for (int id = 0; id < m_numThreads; ++id) {
+      stats.busyTime += m_workers[id].busy;
+      stats.busyMax = max(stats.busyMax, m_workers[id].busy);
+      stats.steals += m_workers[id].steals;
+   }
+   for (int id = 0; id < m_numThreads; ++id) {
+      double makespan = 0.0;
+      for (int i = id; i < n; i += m_numThreads)
+         makespan += m_iterTime[i];
+      stats.staticMakespan = max(stats.staticMakespan, makespan);
+   }
+
+   if (m_error)
+      rethrow_exception(m_error);
+   return stats;
+}
+
+void WorkStealingPool::loop(int id) {
+   uint64_t seen = 0;
+   while (true) {
+      {
+         unique_lock<mutex> lock(m_mutex);
+         m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+         if (m_stop)
+            return;
+         seen = m_generation;
+      }
+
+      work(id);
+
+      {
+         lock_guard<mutex> lock(m_mutex);
+         --m_running;
+      }
+      m_done.notify_one();
+   }
+}
+
+void WorkStealingPool::work(int id) {
+   auto &w = m_workers[id];
+   int i;
+   do {
+      while (pop(w, i)) {
+         const auto t0 = chrono::steady_clock::now();
+         try {
+            m_body(m_fn, i);
+         } catch (...) {
+            lock_guard<mutex> lock(m_mutex);
+            if (!m_error)
+               m_error = current_exception();
+         }
+         m_iterTime[i] = secondsSince(t0);
+      }
+   } while (steal(id));
+
+   w.busy = secondsSince(m_start);
+}
+
+bool WorkStealingPool::pop(Worker &w, int &i) {
+   uint64_t block = w.block.load(memory_order_acquire);
+   while (blockBegin(block) < blockEnd(block)) {
+      const uint64_t next = pack(blockBegin(block) + 1, blockEnd(block));
+      if (w.block.compare_exchange_weak(block, next, memory_order_acq_rel)) {
+         i = blockBegin(block);
+         return true;
+      }
+   }
+   return false;
+}
+
+bool WorkStealingPool::steal(int id) {
+   // Visits the other threads in a fixed order starting after this one, so
+   // that thieves spread over different victims.
+   for (int k = 1; k < m_numThreads; ++k) {
+      auto &victim = m_workers[(id + k) % m_numThreads];
+      uint64_t block = victim.block.load(memory_order_acquire);
+      while (blockBegin(block) < blockEnd(block)) {
+         const uint32_t begin = blockBegin(block);
+         const uint32_t end = blockEnd(block);
+         const uint32_t mid = begin + (end - begin) / 2;
+         if (victim.block.compare_exchange_weak(block, pack(begin, mid), memory_order_acq_rel)) {
+            // The block of this thread is empty, so no other thread writes it.
+            m_workers[id].block.store(pack(mid, end), memory_order_release);
+            ++m_workers[id].steals;
+            return true;
+         }
+      }
+   }
+   return false;
+}
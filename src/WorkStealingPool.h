@@ -0,0 +1,130 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads that run the iterations of a loop, balancing the load
+ * by work stealing.
+ *
+ * Each thread starts with a contiguous block of iterations and takes them
+ * from the front of its block. A thread that runs out of iterations steals
+ * the back half of the remaining block of another thread. Blocks are packed
+ * into one atomic word, so taking and stealing iterations are lock-free.
+ * The calling thread takes part in the loop as thread 0.
+ */
+class WorkStealingPool {
+public:
+   /// Load balance of a loop. Times are in seconds.
+   struct Stats {
+      int threads {0};
+      int iterations {0};
+      uint64_t steals {0};
+
+      /// Time from the start of the loop until the last thread finished.
+      double wallTime {0.0};
+
+      /// Time each thread spent running iterations, summed and the largest.
+      double busyTime {0.0};
+      double busyMax {0.0};
+
+      /// Time the slowest thread would take if the iterations were assigned
+      /// round-robin, with no balancing, as in `schedule(static, 1)`.
+      double staticMakespan {0.0};
+
+      /// Fraction of the thread time spent waiting for the other threads.
+      double idleFraction() const {
+         return wallTime > 0.0 ? 1.0 - busyTime/(threads*wallTime) : 0.0;
+      }
+   };
+
+   /// Creates a pool of `threads` threads, counting the calling one. Zero
+   /// takes one per hardware thread.
+   explicit WorkStealingPool(int threads = 0);
+   ~WorkStealingPool();
+
+   WorkStealingPool(const WorkStealingPool &) = delete;
+   WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+   int numThreads() const {
+      return m_numThreads;
+   }
+
+   /// Runs `fn(i)` for all `i` in [0, n) and waits for them to finish.
+   /// Rethrows the first exception thrown by `fn`, if any. Not reentrant.
+   template <typename Fn>
+   Stats run(int n, const Fn &fn) {
+      // Type erasure without allocating, as std::function might.
+      return run(n, [] (const void *f, int i) { (*static_cast<const Fn*>(f))(i); }, &fn);
+   }
+
+private:
+   typedef void (*Body)(const void *fn, int i);
+
+   struct alignas(64) Worker {
+      // Block of iterations left, `end` in the high half and `begin` in the low.
+      std::atomic<uint64_t> block {0};
+      double busy {0.0};
+      uint64_t steals {0};
+   };
+
+   Stats run(int n, Body body, const void *fn);
+   void loop(int id);
+   void work(int id);
+   bool pop(Worker &w, int &i);
+   bool steal(int id);
+
+   int m_numThreads;
+   std::unique_ptr<Worker[]> m_workers;
+   std::vector<std::thread> m_threads;
+
+   // Duration of each iteration, for the statistics.
+   std::vector<double> m_iterTime;
+
+   std::mutex m_mutex;
+   std::condition_variable m_wake;
+   std::condition_variable m_done;
+   uint64_t m_generation {0};
+   int m_running {0};
+   bool m_stop {false};
+   Body m_body {nullptr};
+   const void *m_fn {nullptr};
+   std::exception_ptr m_error;
+   std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,338 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "Instance.h"
+#include "Profiler.h"
+#include "SortingDecoder.h"
+#include "Timer.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+// Counts the heap allocations made through operator new, so the benchmark
+// can check that decoding does not allocate memory in steady state.
+static atomic<long> heapAllocations {0};
+
+void *operator new(size_t size) {
+   heapAllocations.fetch_add(1, memory_order_relaxed);
+   if (void *ptr = malloc(size ? size : 1))
+      return ptr;
+   throw bad_alloc();
+}
+
+void *operator new(size_t size, align_val_t align) {
+   heapAllocations.fetch_add(1, memory_order_relaxed);
+   const size_t al = static_cast<size_t>(align);
+   if (void *ptr = aligned_alloc(al, (size + al - 1) / al * al))
+      return ptr;
+   throw bad_alloc();
+}
+
+void *operator new[](size_t size) {
+   return operator new(size);
+}
+
+void *operator new[](size_t size, align_val_t align) {
+   return operator new(size, align);
+}
+
+void operator delete(void *ptr) noexcept {
+   free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+   free(ptr);
+}
+
+void operator delete(void *ptr, align_val_t) noexcept {
+   free(ptr);
+}
+
+void operator delete(void *ptr, size_t, align_val_t) noexcept {
+   free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+   free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+   free(ptr);
+}
+
+void operator delete[](void *ptr, align_val_t) noexcept {
+   free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, align_val_t) noexcept {
+   free(ptr);
+}
+
+/// Measures the decoding throughput on random chromosomes, along with the
+/// memory used by the instance data.
+int main(int argc, char* argv[]) {
+   namespace po = boost::program_options;
+   po::options_description desc("Accepted command options are");
+   desc.add_options()
+      ("help,h", "shows this text")
+      ("instance,i", po::value<string>(), "path to the instance file")
+      ("seed,s", po::value<int>()->default_value(1), "seed for the PRNG")
+      ("samples,n", po::value<int>()->default_value(1000), "number of chromosomes to decode")
+      ("threads,t", po::value<int>()->default_value(1), "number of threads decoding in parallel")
+      ("isa", po::value<string>()->default_value("auto"), "instruction set of the insertion "
+       "kernels. Accepted values: auto, scalar, avx2, avx512")
+      ("perturb", po::value<int>()->default_value(0), "if positive, each chromosome differs from "
+       "the previous one in this number of keys, as in path relinking")
+      ("passes", po::value<int>()->default_value(1), "number of times the chromosomes are decoded")
+      ("cache", po::value<int>()->default_value(0), "number of entries of the fitness cache")
+      ("checkpoints", po::value<int>()->default_value(0), "number of decodings kept as "
+       "checkpoints by each thread")
+      ("team-threads", po::value<int>()->default_value(1), "threads that may evaluate the candidates "
+       "of a single task when decodings are fewer than them, zero for one per processor, one disables it. "
+       "Otherwise, nested OpenMP parallelism is enabled for the whole process")
+      ("batch", "decodes each pass as a batch on the work-stealing pool of the decoder, "
+       "instead of an OpenMP loop, and reports the load balance")
+      ("std-sort", "sorts the keys with std::sort")
+      ("no-pruning", "evaluates all vehicle pairs of double services")
+      ("verify", "checks that the cost-only decoding matches the complete one bit by bit, "
+       "and that the key sorting matches std::sort")
+      ("numeric", po::value<string>()->default_value("double"), "arithmetic of the decoding. "
+       "Accepted values: double, float32, fixed32")
+      ("validate-numeric", "decodes the chromosomes in each numeric mode, and reports how far "
+       "their costs are from those of the double precision decoder")
+      ("dist", po::value<string>()->default_value("auto"), "backend of distance lookups. Accepted "
+       "values: auto, dense, triangular, euclidean")
+      ("granular", po::value<int>()->default_value(0), "size of the neighbourhood lists "
+       "of the granular decoding, zero disables it")
+   ;
+
+   po::variables_map args;
+   po::store(po::parse_command_line(argc, argv, desc), args);
+   po::notify(args);
+
+   if (args.count("help") || !args.count("instance")) {
+      cout << desc << "\n";
+      return EXIT_FAILURE;
+   }
+
+   try {
+      const string instFile = args["instance"].as<string>();
+      const int samples = args["samples"].as<int>();
+      const int threads = args["threads"].as<int>();
+
+      Timer tm;
+      tm.start();
+      Instance inst(instFile.c_str(), Instance::distanceKindFromName(args["dist"].as<string>()));
+      tm.finish();
+
+      cout << "Instance: " << instFile << "\n";
+      cout << "Problem contains " << (inst.numNodes() - 2) <<
+         " patients and " << inst.numVehicles() << " caregivers.\n";
+      cout << "Load time: " << tm.elapsed() << " s\n";
+      cout << "Distance backend: " << Instance::distanceKindName(inst.distanceKind()) <<
+         " (" << inst.distanceBytes()/1048576.0 << " MB)\n";
+
+      tm.start();
+      SortingDecoder decoder(inst, args["granular"].as<int>());
+      tm.finish();
+      decoder.kernels = &insertionKernels(kernelIsaFromName(args["isa"].as<string>()));
+      cout << "Insertion kernels: " << decoder.kernels->name << "\n";
+      decoder.pruning = !args.count("no-pruning");
+      decoder.fastSort = !args.count("std-sort");
+      decoder.cache.setCapacity(max(args["cache"].as<int>(), 0));
+      decoder.checkpointSlots = args["checkpoints"].as<int>();
+      decoder.batchThreads = threads;
+      decoder.teamThreads = args["team-threads"].as<int>();
+      decoder.enableTeams();
+      decoder.setNumericMode(numericModeFromName(args["numeric"].as<string>()));
+      if (decoder.numericMode() != NUMERIC_DOUBLE)
+         cout << "Numeric mode: " << numericModeName(decoder.numericMode()) << "\n";
+      const bool batch = args.count("batch");
+      if (decoder.granularity > 0)
+         cout << "Granular neighbourhoods of " << decoder.granularity << " patients built in " <<
+            tm.elapsed() << " s\n";
+      mt19937 rng(args["seed"].as<int>());
+      uniform_real_distribution<double> unif(0.0, 1.0);
+
+      // Chromosomes are generated beforehand to measure only the decoding.
+      vector<vector<double>> population(samples, vector<double>(decoder.chromosomeLength()));
+      const int perturb = args["perturb"].as<int>();
+      for (int i = 0; i < samples; ++i) {
+         auto &chr = population[i];
+         if (perturb > 0 && i > 0) {
+            chr = population[i-1];
+            for (int k = 0; k < perturb; ++k)
+               chr[rng() % chr.size()] = unif(rng);
+         } else {
+            for (auto &key: chr)
+               key = unif(rng);
+         }
+      }
+
+      // Warms up the workspace of each thread.
+      vector<double> fitness(max(samples, 16*threads));
+      if (batch) {
+         const vector<vector<double>> warmUp(16*threads, population[0]);
+         decoder.decodeBatch({warmUp.data(), warmUp.data() + warmUp.size()}, fitness.data());
+      } else {
+         #pragma omp parallel num_threads(threads)
+         decoder.decode(population[0], false);
+      }
+
+      double costSum = 0.0;
+      WorkStealingPool::Stats balance;
+      const long allocsBefore = heapAllocations.load();
+      tm.start();
+      const int passes = args["passes"].as<int>();
+      if (batch) {
+         for (int p = 0; p < passes; ++p) {
+            const auto stats = decoder.decodeBatch({population.data(), population.data() + samples}, fitness.data());
+            for (double f: fitness)
+               costSum += f;
+            balance.threads = stats.threads;
+            balance.iterations += stats.iterations;
+            balance.steals += stats.steals;
+            balance.wallTime += stats.wallTime;
+            balance.busyTime += stats.busyTime;
+            balance.busyMax += stats.busyMax;
+            balance.staticMakespan += stats.staticMakespan;
+         }
+      } else {
+         #pragma omp parallel for num_threads(threads) schedule(dynamic, 1) reduction(+:costSum)
+         for (int i = 0; i < samples*passes; ++i)
+            costSum += decoder.decode(population[i % samples], false);
+      }
+      tm.finish();
+      const long allocs = heapAllocations.load() - allocsBefore;
+
+      cout << "Decoded " << samples*passes << " chromosomes in " << tm.elapsed() << " s (" <<
+         1e6*tm.elapsed()/(samples*passes) << " us per chromosome) using " <<
+         decoder.numWorkspaces() << " thread(s)\n";
+      cout << "Heap allocations while decoding: " << allocs << " (" <<
+         static_cast<double>(allocs)/(samples*passes) << " per chromosome)\n";
+      cout << "Average cost: " << costSum/(samples*passes) << "\n";
+      if (batch) {
+         cout << "Batch load balance: " << 100.0*balance.idleFraction() << "% of thread time idle, " <<
+            balance.steals << " steals\n";
+         cout << "Batch time: " << balance.wallTime << " s, slowest thread busy " << balance.busyMax <<
+            " s, static round-robin schedule would take " << balance.staticMakespan << " s\n";
+      }
+
+      const auto stats = decoder.stats();
+      if (stats.pairsConsidered > 0)
+         cout << "Vehicle pairs pruned: " << 100.0*(stats.pairsConsidered - stats.pairsEvaluated)/stats.pairsConsidered <<
+            "% of " << stats.pairsConsidered << "\n";
+      if (decoder.cache.enabled()) {
+         const auto cacheStats = decoder.cache.stats();
+         cout << "Fitness cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, " <<
+            cacheStats.evictions << " evictions, " << cacheStats.capacity << " entries\n";
+      }
+      if (stats.tasksDecoded + stats.tasksSkipped > 0)
+         cout << "Tasks resumed from checkpoints: " <<
+            100.0*stats.tasksSkipped/(stats.tasksDecoded + stats.tasksSkipped) << "%\n";
+      if (stats.teamTasks > 0)
+         cout << "Tasks evaluated by teams of threads: " << stats.teamTasks << "\n";
+      cout << "Key sorts: " << stats.fullSorts << " full, " << stats.incrementalSorts << " incremental\n";
+
+      if (args.count("verify")) {
+         int mismatches = 0, sortMismatches = 0;
+         KeySorter fast, reference;
+         for (const auto &chr: population) {
+            const int n = decoder.allTasks.size();
+            if (fast.sort(chr.data(), n) != reference.sort(chr.data(), n, false))
+               ++sortMismatches;
+
+            const double cost = decoder.decode(chr, false);
+            const double full = decoder.decodeSolution(chr).cachedCost;
+            if (memcmp(&cost, &full, sizeof(double)) != 0)
+               ++mismatches;
+         }
+         cout << "Cost-only decoding mismatches: " << mismatches << " out of " << samples << "\n";
+         cout << "Key sort mismatches with std::sort: " << sortMismatches << " out of " << samples << "\n";
+         if (mismatches > 0 || sortMismatches > 0)
+            return EXIT_FAILURE;
+      }
+
+      if (args.count("validate-numeric")) {
+         vector<double> reference(samples);
+         for (int i = 0; i < samples; ++i)
+            reference[i] = decoder.decodeSolution(population[i]).cachedCost;
+
+         cout << "Numeric modes against the double precision decoder:\n";
+         bool exact = true;
+         KeySorter sorter;
+         for (auto mode: {NUMERIC_DOUBLE, NUMERIC_FLOAT32, NUMERIC_FIXED32}) {
+            const auto numeric = NumericDecoder::create(mode, inst, decoder.allTasks, decoder.granularity,
+               decoder.neighbours);
+            double maxDiff = 0.0, sumDiff = 0.0;
+            int differ = 0;
+            tm.start();
+            for (int i = 0; i < samples; ++i) {
+               const auto &chr = population[i];
+               const double cost = numeric->decode(chr, sorter.sort(chr.data(), decoder.allTasks.size()));
+               const double diff = abs(cost - reference[i]) / max(abs(reference[i]), 1e-12);
+               maxDiff = max(maxDiff, diff);
+               sumDiff += diff;
+               differ += cost != reference[i];
+            }
+            tm.finish();
+
+            cout << "  " << numericModeName(mode) << ": tables of " << numeric->bytes()/1048576.0 << " MB, " <<
+               1e6*tm.elapsed()/samples << " us per chromosome, relative difference " << sumDiff/samples <<
+               " on average and " << maxDiff << " at most, " << differ << " out of " << samples <<
+               " costs differ\n";
+            if (mode == NUMERIC_DOUBLE && differ > 0)
+               exact = false;
+         }
+         if (!exact)
+            return EXIT_FAILURE;
+      }
+   } catch (const exception &e) {
+      cout << "Error: " << e.what() << endl;
+      return EXIT_FAILURE;
+   }
+
+#ifdef ENABLE_PROFILER
+   Profiler::report(cout);
+#endif
+
+   return EXIT_SUCCESS;
+}
@@ -27,14 +27,22 @@
  */
 
 #include "Instance.h"
+#include "LocalSearch.h"
+#include "Profiler.h"
+#include "SolutionArchive.h"
+#include "SolverState.h"
 #include "SortingDecoder.h"
+#include "Telemetry.h"
 #include "Timer.h"
 
 #include "brkga_mp_ipr.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <sstream>
@@ -49,6 +57,9 @@ boost::program_options::variables_map parseCommandline(int argc, char **argv);
 /// Converts the parameters to the format that BRKGA library uses.
 BRKGA::BrkgaParams extractFrom(boost::program_options::variables_map &vm);
 
+/// Reads the instance file, or terminates the program reporting the parsing error.
+Instance readInstance(const string &fname, const string &distKind);
+
 /// Prints some metrics regarding the number of qualified caregivers, 
 /// and the number of service requests, per service type.
 void printSupplyDemandIndicators(const Instance &inst);
@@ -56,7 +67,19 @@ void printSupplyDemandIndicators(const Instance &inst);
 /// Computes the average and standard deviation of elite set of the GA.
 tuple<double, double> computeEliteDiversity(const BRKGA::BRKGA_MP_IPR<SortingDecoder> &solver);
 
+/// Chromosome whose keys sort the tasks in the insertion order of `sol`. The
+/// keys of `source` are reassigned by rank, and its last two keys are kept.
+vector<double> encodeInsertOrder(const Solution &sol, const vector<double> &source);
+
 int main(int argc, char* argv[]) {
+   // The time limit counts from the start of the program. A resumed run
+   // counts from the start of the interrupted one, as if started earlier
+   // by the time that run had elapsed.
+   auto startTime = chrono::steady_clock::now();
+   auto runTime = [&startTime] () {
+      return chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+   };
+
    // Parses command line arguments.
    auto args = parseCommandline(argc, argv);
    auto brkga_params = extractFrom(args);
@@ -71,9 +94,11 @@ int main(int argc, char* argv[]) {
    // Reads the problem instance.
    const string instFile = args["instance"].as<string>();
    cout << "Parsing instance file...\n";
-   auto instance = Instance(instFile.c_str());
+   auto instance = readInstance(instFile, args["dist"].as<string>());
    cout << "Problem contains " << (instance.numNodes() - 2) << 
       " patients and " << instance.numVehicles() << " caregivers.\n";
+   cout << "Distance backend: " << Instance::distanceKindName(instance.distanceKind()) <<
+      " (" << instance.distanceBytes()/1048576.0 << " MB)\n";
    printSupplyDemandIndicators(instance);
    cout << endl;
 
@@ -114,24 +139,54 @@ int main(int argc, char* argv[]) {
       }
 
       cout << "Initializing genetic algorithm...\n";
-      SortingDecoder decoder(instance);
-      BRKGA::BRKGA_MP_IPR<SortingDecoder> algorithm(
+      SortingDecoder decoder(instance, args["granular"].as<int>());
+      cout << "Insertion kernels: " << decoder.kernels->name << "\n";
+      decoder.cache.setCapacity(max(args["cache"].as<int>(), 0));
+      decoder.checkpointSlots = args["checkpoints"].as<int>();
+      decoder.teamThreads = args["team-threads"].as<int>();
+      decoder.enableTeams();
+      decoder.setNumericMode(numericModeFromName(args["numeric"].as<string>()));
+      if (decoder.numericMode() != NUMERIC_DOUBLE)
+         cout << "Population decoded in numeric mode " << numericModeName(decoder.numericMode()) <<
+            ", solutions reported in double precision.\n";
+      if (decoder.granularity > 0)
+         cout << "Granular decoding with neighbourhoods of " << decoder.granularity << " patients.\n";
+      ResumableBrkga<SortingDecoder> algorithm(
          decoder, BRKGA::Sense::MINIMIZE, seed,
          decoder.chromosomeLength(), brkga_params, omp_get_max_threads()
       );
       algorithm.initialize();
 
+      const auto searchMode = args["local-search"].as<string>();
+      if (searchMode != "none" && searchMode != "incumbent" && searchMode != "elite") {
+         cout << "Unknown local search mode: " << searchMode << "\n";
+         abort();
+      }
+
+      // One record per generation, for analysing the throughput of the search.
+      unique_ptr<Telemetry> telemetry;
+      if (args.count("telemetry")) {
+         const auto format = Telemetry::formatFromName(args["telemetry-format"].as<string>());
+         telemetry.reset(new Telemetry(args["telemetry"].as<string>(), format));
+         cout << "Telemetry of each generation written to '" << args["telemetry"].as<string>() <<
+            "' in " << Telemetry::formatName(format) << " format.\n";
+      }
+
       // Some other control parameters used within the algorithm.
       const auto prPeriod = args["pperiod"].as<int>();
       const auto resetPeriod = args["reset"].as<long>();
       const auto exchangePeriod = args["xelite"].as<int>();
+      const auto lsPeriod = searchMode != "none" ? args["ls-period"].as<int>() : 0;
       const auto printPeriod = args.count("printall") ? 1 : 50;
+      const double timeLimit = args["time-limit"].as<double>();
+      const uint64_t maxEvals = max<long>(args["max-evals"].as<long>(), 0);
+      const double targetCost = args.count("target-cost") ? args["target-cost"].as<double>() : -1e75;
 
       // Some indicators collected during the run.
       int iprHomogeneous = 0, iprNoImprovement = 0, 
          iprEliteImprovement = 0, iprBestImprovement = 0;
       int linesPrinted = 0;
-      int opIpr = 0, opXe = 0, opRst = 0;
+      int opIpr = 0, opXe = 0, opRst = 0, opLs = 0;
 
       Timer tm;
       unsigned generation = 0;
@@ -140,6 +195,126 @@ int main(int argc, char* argv[]) {
       double localBest = numeric_limits<double>::infinity();
       double dist = localBest, tard = localBest, tmax = localBest;      
 
+      // The best solution is the double precision decoding of the fittest
+      // chromosome, so with a reduced precision `localBest` and `bestFitness`
+      // only select the chromosomes to decode. Its routes are written at the
+      // end if no better solution is found.
+      double bestFitness = localBest;
+      RouteArena bestRoutes;
+
+      // When the best solution was found, and after how many evaluations.
+      double timeToBest = 0.0;
+      uint64_t evalsToBest = 0;
+
+      // Local search applied during the run.
+      LocalSearch periodicSearch(instance, args["ls-granularity"].as<int>());
+      vector<vector<double>> searched;
+      int lsInjected = 0;
+      double lsSeconds = 0.0;
+      if (lsPeriod > 0)
+         cout << "Local search of the " << (searchMode == "elite" ? "elite solutions" : "incumbent") <<
+            " every " << lsPeriod << " generations.\n";
+
+      // Evaluations of the interrupted run, when resuming one, and those of
+      // the initial population replaced by its saved state.
+      uint64_t evalsBefore = 0, evalsDiscarded = 0;
+      auto evaluations = [&] () {
+         return evalsBefore + decoder.stats().decodings - evalsDiscarded;
+      };
+
+      // The state of the run is saved between generations, so that it can be
+      // resumed after an interruption.
+      const string stateFile = args.count("save-state") ? args["save-state"].as<string>() : "";
+      const int savePeriod = args["save-period"].as<int>();
+      int statesSaved = 0;
+      double saveSeconds = 0.0;
+
+      if (args.count("resume")) {
+         const auto &fname = args["resume"].as<string>();
+         const auto state = SolverState::read(fname);
+         algorithm.restoreState(state);
+         generation = state.generation;
+         noImprove = state.noImprove;
+         localBest = state.localBest;
+         overallBest = state.overallBest;
+         dist = state.dist;
+         tard = state.tard;
+         tmax = state.tmax;
+         bestFitness = state.bestFitness;
+         bestRoutes = state.bestRoutes;
+         opLs = state.opLs;
+         lsInjected = state.lsInjected;
+         lsSeconds = state.lsSeconds;
+         searched = state.searched;
+         opIpr = state.opIpr;
+         opXe = state.opXe;
+         opRst = state.opRst;
+         iprHomogeneous = state.iprHomogeneous;
+         iprNoImprovement = state.iprNoImprovement;
+         iprEliteImprovement = state.iprEliteImprovement;
+         iprBestImprovement = state.iprBestImprovement;
+         evalsBefore = state.evaluations;
+         evalsDiscarded = decoder.stats().decodings;
+         evalsToBest = state.evalsToBest;
+         timeToBest = state.timeToBest;
+         startTime -= chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(state.elapsed));
+         cout << "Resuming the run of seed " << state.seed << " saved in '" << fname <<
+            "' at generation " << generation << ".\n";
+      }
+
+      // Each improvement of the best solution is recorded by a background
+      // thread. A resumed run appends to the archive of the interrupted one.
+      unique_ptr<SolutionArchive> archive;
+      if (args.count("archive")) {
+         const auto &fname = args["archive"].as<string>();
+         if (args.count("resume"))
+            archive.reset(new SolutionArchive(fname, instance.fileName(), seed, generation, runTime()));
+         else
+            archive.reset(new SolutionArchive(fname, instance.fileName(), seed));
+         cout << "Improving solutions recorded in archive '" << fname << "'.\n";
+      }
+
+      if (timeLimit > 0.0)
+         periodicSearch.deadline = startTime + chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(timeLimit));
+      if (!stateFile.empty() && savePeriod > 0)
+         cout << "Solver state saved to '" << stateFile << "' every " << savePeriod << " generations.\n";
+
+      auto saveState = [&] () {
+         const auto saveStart = chrono::steady_clock::now();
+         SolverState state;
+         algorithm.saveState(state);
+         state.seed = seed;
+         state.generation = generation;
+         state.noImprove = noImprove;
+         state.localBest = localBest;
+         state.overallBest = overallBest;
+         state.dist = dist;
+         state.tard = tard;
+         state.tmax = tmax;
+         state.bestFitness = bestFitness;
+         state.bestRoutes = bestRoutes;
+         state.opLs = opLs;
+         state.lsInjected = lsInjected;
+         state.lsSeconds = lsSeconds;
+         state.searched = searched;
+         state.opIpr = opIpr;
+         state.opXe = opXe;
+         state.opRst = opRst;
+         state.iprHomogeneous = iprHomogeneous;
+         state.iprNoImprovement = iprNoImprovement;
+         state.iprEliteImprovement = iprEliteImprovement;
+         state.iprBestImprovement = iprBestImprovement;
+         state.evaluations = evaluations();
+         state.evalsToBest = evalsToBest;
+         state.timeToBest = timeToBest;
+         state.elapsed = runTime();
+         state.write(stateFile);
+         saveSeconds += chrono::duration<double>(chrono::steady_clock::now() - saveStart).count();
+         ++statesSaved;
+      };
+
       // Prints the header of algorithm output.
       auto printHeader = [] () {
          cout << "\n";
@@ -203,64 +378,158 @@ int main(int argc, char* argv[]) {
          evt = "";
       };
       
-      cout << "Stopping criteria: " << instance.numNodes()/2 << " staled generations, maximum of "<< num_generations << " generations.\n";
+      cout << "Stopping criteria: " << instance.numNodes()/2 << " staled generations, maximum of "<< num_generations << " generations";
+      if (timeLimit > 0.0)
+         cout << ", " << timeLimit << " seconds";
+      if (maxEvals > 0)
+         cout << ", " << maxEvals << " evaluations";
+      if (args.count("target-cost"))
+         cout << ", target cost of " << targetCost;
+      cout << ".\n";
 
       printHeader();
       tm.start();
+      DecoderTelemetry lastTelemetry = decoder.telemetry();
+      double lastRecordTime = runTime();
       do {
          bool hasImproved = false;
-         algorithm.evolve();         
+         string prResult = "";
+         double prTime = 0.0;
+         {
+            PROFILE_ZONE("evolve");
+            algorithm.evolve();
+         }
          
          if (localBest >= numeric_limits<double>::infinity()) {
             localBest = algorithm.getBestFitness(); 
             hasImproved = true;
          }
          
-         if (localBest < overallBest) {
-            overallBest = localBest;
+         if (localBest < bestFitness) {
+            bestFitness = localBest;
             const auto sol = decoder.decodeSolution(algorithm.getBestChromosome());
-            dist = sol.dist;
-            tard = sol.tard;
-            tmax = sol.tmax;
-            hdr = '*';
+            if (sol.cachedCost < overallBest) {
+               overallBest = sol.cachedCost;
+               dist = sol.dist;
+               tard = sol.tard;
+               tmax = sol.tmax;
+               bestRoutes = sol.routes;
+               hdr = '*';
+               timeToBest = runTime();
+               evalsToBest = evaluations();
+               if (archive)
+                  archive->record(sol, algorithm.getBestChromosome(), generation);
+            }
          }
 
          if (generation % printPeriod == 0 || hasImproved || hdr == '*') {
             printProgress();
          }
 
-         if (prPeriod > 0 && generation > 0 && generation % prPeriod == 0) {
+         // Path relinking is limited to the time left, and skipped when less
+         // than a second is left (the limit of the library is in whole seconds)
+         // or the evaluation budget is exhausted.
+         const double timeLeft = timeLimit > 0.0 ? timeLimit - runTime() : 0.0;
+         const bool budgetLeft = (timeLimit <= 0.0 || timeLeft >= 1.0) &&
+            (maxEvals == 0 || evaluations() < maxEvals);
+         if (prPeriod > 0 && generation > 0 && generation % prPeriod == 0 && !budgetLeft) {
+            cout << "Path relinking skipped: no time or evaluations left.\n";
+         } else if (prPeriod > 0 && generation > 0 && generation % prPeriod == 0) {
             using BRKGA::PathRelinking::PathRelinkingResult;
             evt += 'P';
             opIpr++;
-            PathRelinkingResult result = algorithm.pathRelink(distFuncPtr);
-            cout << "Path relinking result: ";
+            const double prStart = runTime();
+            PathRelinkingResult result;
+            {
+               PROFILE_ZONE("pathRelink");
+               result = algorithm.pathRelink(distFuncPtr, long(timeLeft));
+            }
+            prTime = runTime() - prStart;
             switch(result) {
                case PathRelinkingResult::TOO_HOMOGENEOUS:
-                  cout << "too homogeneous.";
+                  prResult = "too homogeneous";
                   iprHomogeneous++;
                   break;
                case PathRelinkingResult::NO_IMPROVEMENT:
-                  cout << "no improvement.";
+                  prResult = "no improvement";
                   iprNoImprovement++;
                   break;
                case PathRelinkingResult::ELITE_IMPROVEMENT:
-                  cout << "elite improvement.";
+                  prResult = "elite improvement";
                   iprEliteImprovement++;
                   break;
                case PathRelinkingResult::BEST_IMPROVEMENT:
-                  cout << "best improvement.";
+                  prResult = "best improvement";
                   iprBestImprovement++;
                   break;
             }
-            cout << "\n";
+            cout << "Path relinking result: " << prResult << ".\n";
          }
 
          if (exchangePeriod > 0 && generation > 0 && brkga_params.num_independent_populations > 1 && generation % exchangePeriod == 0) {
             evt += 'X';
             opXe++;
+            PROFILE_ZONE("exchangeElite");
             algorithm.exchangeElite(immigrants);
          }
+
+         // The insertion order of the improved routes is injected as a
+         // chromosome in place of the worst one of the population, with the
+         // fitness it decodes to.
+         if (lsPeriod > 0 && generation > 0 && generation % lsPeriod == 0) {
+            evt += 'L';
+            opLs++;
+            PROFILE_ZONE("localSearch");
+            const auto lsStart = chrono::steady_clock::now();
+            const auto &params = algorithm.getBrkgaParams();
+            vector<pair<unsigned, vector<double>>> sources;
+            if (searchMode == "elite") {
+               const unsigned numElites = params.population_size * params.elite_percentage;
+               for (unsigned k = 0; k < params.num_independent_populations; ++k)
+                  for (unsigned i = 0; i < numElites; ++i)
+                     sources.emplace_back(k, algorithm.getChromosome(k, i));
+            } else {
+               unsigned best = 0;
+               for (unsigned k = 1; k < params.num_independent_populations; ++k)
+                  if (algorithm.getFitness(k, 0) < algorithm.getFitness(best, 0))
+                     best = k;
+               sources.emplace_back(best, algorithm.getChromosome(best, 0));
+            }
+
+            // Chromosomes already searched in the previous run are skipped.
+            vector<vector<double>> searching;
+            for (const auto &[k, source]: sources) {
+               searching.push_back(source);
+               if (find(searched.begin(), searched.end(), source) != searched.end())
+                  continue;
+               auto sol = decoder.decodeSolution(source);
+               if (!periodicSearch.improve(sol))
+                  continue;
+
+               if (sol.cachedCost < overallBest) {
+                  overallBest = sol.cachedCost;
+                  dist = sol.dist;
+                  tard = sol.tard;
+                  tmax = sol.tmax;
+                  hdr = '*';
+                  timeToBest = runTime();
+                  evalsToBest = evaluations();
+                  if (archive)
+                     archive->record(sol, source, generation, true);
+                  bestRoutes = sol.routes;
+               }
+
+               const auto chromosome = encodeInsertOrder(sol, source);
+               const double fitness = decoder.decode(chromosome, false);
+               const unsigned worst = params.population_size - 1;
+               if (fitness < algorithm.getFitness(k, worst)) {
+                  algorithm.injectChromosome(chromosome, k, worst, fitness);
+                  ++lsInjected;
+               }
+            }
+            searched.swap(searching);
+            lsSeconds += chrono::duration<double>(chrono::steady_clock::now() - lsStart).count();
+         }
          
          if (localBest - algorithm.getBestFitness() < 0.05) {
             ++noImprove;
@@ -273,14 +542,36 @@ int main(int argc, char* argv[]) {
             evt += 'R';
             opRst++;
             localBest = numeric_limits<double>::infinity();
+            PROFILE_ZONE("reset");
             algorithm.reset();
             noImprove = 0;
          }
 
+         const string events = evt;
          if (!evt.empty()) {
             printProgress();
          }
 
+         if (telemetry) {
+            const auto totals = decoder.telemetry();
+            Telemetry::Record rec;
+            rec.generation = generation;
+            rec.elapsed = runTime();
+            rec.generationTime = rec.elapsed - lastRecordTime;
+            rec.evaluations = evaluations();
+            rec.decoder = totals.since(lastTelemetry);
+            rec.localBest = localBest;
+            rec.overallBest = overallBest;
+            tie(rec.eliteMean, rec.eliteStdev) = computeEliteDiversity(algorithm);
+            rec.noImprove = noImprove;
+            rec.events = events;
+            rec.prResult = prResult;
+            rec.prTime = prTime;
+            telemetry->write(rec);
+            lastTelemetry = totals;
+            lastRecordTime = rec.elapsed;
+         }
+
          ++generation;
 
          // New stopping criteria: by iterations without improvement.
@@ -288,6 +579,28 @@ int main(int argc, char* argv[]) {
             cout << "Stopping a stale search.\n";
             break;
          }
+
+         // Budgets are checked between generations, so a generation started
+         // before reaching them is completed.
+         if (overallBest <= targetCost) {
+            cout << "Stopping on reaching the target cost.\n";
+            break;
+         }
+         if (timeLimit > 0.0 && runTime() >= timeLimit) {
+            cout << "Stopping on reaching the time limit.\n";
+            break;
+         }
+         if (maxEvals > 0 && evaluations() >= maxEvals) {
+            cout << "Stopping on exhausting the evaluation budget.\n";
+            break;
+         }
+
+         // Saved only when the loop goes on, so the resumed run starts by
+         // evolving the next generation, as this one would.
+         if (!stateFile.empty() && savePeriod > 0 && generation % savePeriod == 0 &&
+               generation < num_generations) {
+            saveState();
+         }
       } while (generation < num_generations);
 
       printProgress(); 
@@ -303,6 +616,62 @@ int main(int argc, char* argv[]) {
          }
          close(fid);
          auto sol = decoder.decodeSolution(algorithm.getBestChromosome());
+         const double before = sol.cachedCost;
+         const vector<double> *source = &algorithm.getBestChromosome();
+         if (searchMode != "none") {
+            Timer searchTime;
+            searchTime.start();
+            LocalSearch search(instance, args["ls-granularity"].as<int>());
+            if (timeLimit > 0.0)
+               search.deadline = startTime + chrono::duration_cast<chrono::steady_clock::duration>(
+                  chrono::duration<double>(timeLimit));
+            search.improve(sol);
+
+            if (searchMode == "elite") {
+               const auto &params = algorithm.getBrkgaParams();
+               const unsigned numElites = params.population_size * params.elite_percentage;
+               for (unsigned k = 0; k < params.num_independent_populations; ++k) {
+                  for (unsigned i = 0; i < numElites; ++i) {
+                     auto other = decoder.decodeSolution(algorithm.getChromosome(k, i));
+                     search.improve(other);
+                     if (other.cachedCost < sol.cachedCost) {
+                        sol = other;
+                        source = &algorithm.getChromosome(k, i);
+                     }
+                  }
+               }
+            }
+            searchTime.finish();
+
+            const auto &st = search.stats;
+            cout << "Local search of the " << (searchMode == "elite" ? "elite solutions" : "incumbent") <<
+               " in " << searchTime.elapsed() << " seconds: cost from " << before << " to " << sol.cachedCost << "\n";
+            cout << "Moves applied: " << st.relocations << " relocations, " << st.swaps << " swaps, " <<
+               st.twoOptStars << " 2-opt*, " << st.reassignments << " re-assignments\n";
+            cout << "Moves considered: " << st.movesConsidered << ", " <<
+               100.0*st.movesBounded/max<uint64_t>(st.movesConsidered, 1) << "% rejected by their bounds, " <<
+               st.movesRetimed << " re-timed (" << double(st.visitsRetimed)/max<uint64_t>(st.movesRetimed, 1) <<
+               " visits each), " << st.movesCyclic << " with circular synchronisations\n";
+         }
+
+         // Otherwise, the best solution may have left the populations, or been
+         // ranked below others by a fitness of reduced precision.
+         if (sol.cachedCost < overallBest) {
+            overallBest = sol.cachedCost;
+            dist = sol.dist;
+            tard = sol.tard;
+            tmax = sol.tmax;
+            timeToBest = runTime();
+            evalsToBest = evaluations();
+            if (archive)
+               archive->record(sol, *source, generation, sol.cachedCost < before);
+         } else if (overallBest < sol.cachedCost && bestRoutes.numRoutes() > 0) {
+            sol.routes = bestRoutes;
+            sol.cachedCost = overallBest;
+            sol.dist = dist;
+            sol.tard = tard;
+            sol.tmax = tmax;
+         }
          sol.writeFile(buf, seed);
          cout << "Solution written to '" << buf << "'.\n";
 
@@ -317,14 +686,50 @@ int main(int argc, char* argv[]) {
          cout << "(total = " << idle << " out of " << instance.numVehicles() << ")" << "\n";
       }
 
+      if (archive) {
+         archive->close();
+         cout << "Solutions recorded in the archive: " << archive->recordsWritten() << "\n";
+         if (archive->failed())
+            cout << "Error writing the solution archive: some records were lost.\n";
+      }
+
 
       cout << "\n---\nSearch finished.\n";
       cout << "Total of " << generation << " generations in " << tm.elapsed() << " seconds.\n";
       cout << "Exchange elite runs: " << opXe << "\n";
       cout << "Implicit path relinking runs: " << opIpr << "\n";
       cout << "Reset attempts: " << opRst << "\n";
+      if (opLs > 0)
+         cout << "Local search runs: " << opLs << ", " << lsInjected << " chromosomes injected, " <<
+            lsSeconds << " seconds\n";
+      const auto decStats = decoder.stats();
+      cout << "Evaluations: " << evaluations() << "\n";
+      cout << "Time to best solution: " << timeToBest << " seconds since the start, after " <<
+         evalsToBest << " evaluations\n";
+      if (statesSaved > 0)
+         cout << "Solver state saved " << statesSaved << " times, " <<
+            1000.0*saveSeconds/statesSaved << " ms each\n";
+      if (decStats.pairsConsidered > 0)
+         cout << "Vehicle pairs pruned by the decoder: " <<
+            100.0*(decStats.pairsConsidered - decStats.pairsEvaluated)/decStats.pairsConsidered << "%\n";
+      if (decStats.tasksDecoded + decStats.tasksSkipped > 0)
+         cout << "Tasks resumed from checkpoints: " <<
+            100.0*decStats.tasksSkipped/(decStats.tasksDecoded + decStats.tasksSkipped) << "%\n";
+      if (decStats.teamTasks > 0)
+         cout << "Tasks evaluated by teams of threads: " << decStats.teamTasks << "\n";
+      if (decoder.cache.enabled()) {
+         const auto cacheStats = decoder.cache.stats();
+         const double lookups = max<double>(cacheStats.hits + cacheStats.misses, 1);
+         cout << "Fitness cache: " << cacheStats.hits << " hits (" << 100.0*cacheStats.hits/lookups <<
+            "%), " << cacheStats.misses << " misses, " << cacheStats.evictions << " evictions\n";
+      }
       cout << "\n";
 
+#ifdef ENABLE_PROFILER
+      Profiler::report(cout);
+      cout << "\n";
+#endif
+
       cout << "Best solution found:\n";
       cout << "   Cost: " << overallBest << "\n";
       cout << "   Total travel time: " << dist << "\n";
@@ -354,6 +759,71 @@ boost::program_options::variables_map parseCommandline(int argc, char **argv) {
 
       ("seed,s", po::value<int>()->default_value(1), "seed for the PRNG")
 
+      ("dist", po::value<string>()->default_value("auto"), "backend of distance lookups. Accepted "
+       "values: auto, dense, triangular, euclidean")
+
+      ("granular", po::value<int>()->default_value(0), "size of the neighbourhood lists used "
+       "by the decoder to restrict the candidate caregivers of each patient. Zero "
+       "evaluates all qualified caregivers")
+
+      ("cache", po::value<int>()->default_value(262144), "number of entries of the cache of "
+       "decoded fitness values. Zero disables the cache")
+
+      ("checkpoints", po::value<int>()->default_value(4), "number of recent decodings whose "
+       "partial solutions are kept by each thread, to resume decodings sharing a prefix "
+       "with them. Zero disables it")
+
+      ("team-threads", po::value<int>()->default_value(1), "threads that may evaluate the "
+       "candidate caregivers of a single patient, used when fewer chromosomes than threads "
+       "are being decoded. Zero takes one per processor, and one disables it. Otherwise, "
+       "nested OpenMP parallelism is enabled for the whole process")
+
+      ("numeric", po::value<string>()->default_value("double"), "arithmetic used to decode "
+       "the population. Accepted values: double, float32 and fixed32 (thousandths of "
+       "time unit in 32-bit integers)")
+
+      ("time-limit", po::value<double>()->default_value(0.0), "wall-clock time limit in "
+       "seconds, counted from the start of the program and including the local search "
+       "of the best solution. Zero disables it")
+
+      ("max-evals", po::value<long>()->default_value(0), "maximum number of chromosomes "
+       "evaluated, including those found in the fitness cache. Zero disables it")
+
+      ("target-cost", po::value<double>(), "stops as soon as a solution of this cost or "
+       "lower is found")
+
+      ("archive", po::value<string>(), "path to a binary archive where each improvement of "
+       "the best solution is recorded, along with its chromosome. The solutions are "
+       "extracted with the extract-solution tool")
+
+      ("save-state", po::value<string>(), "path to a binary file where the state of the "
+       "run is saved periodically, to be resumed with --resume")
+
+      ("save-period", po::value<int>()->default_value(100), "number of generations between "
+       "saving the state of the run")
+
+      ("resume", po::value<string>(), "resumes the run whose state was saved to this file. "
+       "The instance and the parameters must be those of the interrupted run")
+
+      ("telemetry", po::value<string>(), "path to a file where a record of each generation "
+       "is written, with the throughput and decoding times, the counters of the decoder, "
+       "the operators applied and the diversity of the elite")
+
+      ("telemetry-format", po::value<string>()->default_value("jsonl"), "format of the "
+       "telemetry file. Accepted values: jsonl (a JSON object per line) and csv")
+
+      ("local-search", po::value<string>()->default_value("incumbent"), "local search applied "
+       "to the best solution found. Accepted values: none, incumbent, and elite (each elite "
+       "solution of all populations, keeping the best)")
+
+      ("ls-period", po::value<int>()->default_value(0), "number of generations between "
+       "applications of the local search during the run, whose solutions are injected "
+       "back into the populations. Use 0 to apply it only to the final solution")
+
+      ("ls-granularity", po::value<int>()->default_value(50), "moves of the local search "
+       "must create an arc from one of this many nearest time-window compatible "
+       "predecessors of a patient. Use 0 to consider all moves")
+
       ("printall", "log the search progress in each generation, otherwise from "
          "50 to 50 generations, or when a improved solution is found")
 
@@ -480,6 +950,15 @@ BRKGA::BrkgaParams extractFrom(boost::program_options::variables_map &vm) {
    return params;
 }
    
+Instance readInstance(const string &fname, const string &distKind) {
+   try {
+      return Instance(fname.c_str(), Instance::distanceKindFromName(distKind));
+   } catch (const exception &e) {
+      cout << "Error reading instance: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+   }
+}
+
 void printSupplyDemandIndicators(const Instance &inst) {
    cout << "Summary of supply/demand per service type:\n";
    for (int s = 0; s < inst.numSkills(); ++s) {
@@ -517,3 +996,15 @@ tuple<double, double> computeEliteDiversity(const BRKGA::BRKGA_MP_IPR<SortingDec
    stdev = sqrt(stdev);
    return make_tuple(mean, stdev);
 }
+
+vector<double> encodeInsertOrder(const Solution &sol, const vector<double> &source) {
+   // Task i is that of node i+1, as laid out by `createTaskList`.
+   const size_t numTasks = sol.insertOrder.size();
+   vector<double> keys(source.begin(), source.begin() + numTasks);
+   sort(keys.begin(), keys.end());
+
+   vector<double> chromosome(source);
+   for (size_t k = 0; k < numTasks; ++k)
+      chromosome[sol.insertOrder[k].node - 1] = keys[k];
+   return chromosome;
+}
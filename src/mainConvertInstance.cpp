@@ -0,0 +1,78 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "Instance.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/// Converts instance files into the binary cache format read by `Instance`.
+int main(int argc, char* argv[]) {
+   namespace po = boost::program_options;
+   po::options_description desc("Accepted command options are");
+   desc.add_options()
+      ("help,h", "shows this text")
+      ("input,i", po::value<string>(), "path to the instance file (text or binary format)")
+      ("output,o", po::value<string>(), "path to the binary file to be written")
+   ;
+
+   po::variables_map args;
+   po::store(po::parse_command_line(argc, argv, desc), args);
+   po::notify(args);
+
+   if (args.count("help") || !args.count("input") || !args.count("output")) {
+      cout << desc << "\n";
+      return EXIT_FAILURE;
+   }
+
+   const string input = args["input"].as<string>();
+   const string output = args["output"].as<string>();
+
+   try {
+      cout << "Reading instance file '" << input << "'...\n";
+      // Loaded with the dense backend, so that the distances are written
+      // exactly, whatever the size of the instance.
+      Instance inst(input.c_str(), Instance::DIST_DENSE);
+      cout << "Problem contains " << (inst.numNodes() - 2) <<
+         " patients and " << inst.numVehicles() << " caregivers.\n";
+
+      inst.writeBinary(output.c_str());
+      cout << "Binary instance written to '" << output << "'.\n";
+   } catch (const exception &e) {
+      cout << "Error: " << e.what() << endl;
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "SolutionArchive.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/// Lists the records of a solution archive, or extracts one of them in the
+/// text format of the solution files.
+int main(int argc, char* argv[]) {
+   namespace po = boost::program_options;
+   po::options_description desc("Accepted command options are");
+   desc.add_options()
+      ("help,h", "shows this text")
+      ("archive,a", po::value<string>(), "path to the solution archive")
+      ("list,l", "lists the records of the archive")
+      ("record,r", po::value<int>()->default_value(-1), "index of the record to extract. "
+       "Negative values count from the end, so -1 is the last (best) solution")
+      ("output,o", po::value<string>(), "path to the solution file to be written, "
+       "otherwise it is written to the standard output")
+   ;
+
+   po::variables_map args;
+   po::store(po::parse_command_line(argc, argv, desc), args);
+   po::notify(args);
+
+   if (args.count("help") || !args.count("archive")) {
+      cout << desc << "\n";
+      return EXIT_FAILURE;
+   }
+
+   try {
+      const auto contents = SolutionArchive::read(args["archive"].as<string>());
+      const int count = contents.records.size();
+
+      if (args.count("list")) {
+         cout << "Instance: " << contents.instanceName << "\n";
+         cout << "Seed: " << contents.seed << "\n";
+         cout << setw(6) << "Record" << " " << setw(6) << "Gen" << " " << setw(9) << "Time" << " " <<
+            setw(10) << "Cost" << " " << setw(10) << "Dist" << " " << setw(9) << "Tard" << " " <<
+            setw(9) << "TMax" << "  " << "Source" << "\n";
+         for (int i = 0; i < count; ++i) {
+            const auto &r = contents.records[i];
+            cout << fixed <<
+               setw(6) << i << " " <<
+               setw(6) << r.generation << " " <<
+               setw(9) << setprecision(2) << r.elapsed << " " <<
+               setw(10) << setprecision(2) << r.cost << " " <<
+               setw(10) << setprecision(2) << r.dist << " " <<
+               setw(9) << setprecision(1) << r.tard << " " <<
+               setw(9) << setprecision(1) << r.tmax << "  " <<
+               (r.postOptimised ? "local search" : "decoded") << "\n";
+         }
+         return EXIT_SUCCESS;
+      }
+
+      int index = args["record"].as<int>();
+      if (index < 0)
+         index += count;
+      if (index < 0 || index >= count) {
+         cout << "Record " << args["record"].as<int>() << " not found: the archive holds " <<
+            count << " records.\n";
+         return EXIT_FAILURE;
+      }
+
+      const auto &r = contents.records[index];
+      if (args.count("output")) {
+         const string output = args["output"].as<string>();
+         ofstream fid(output);
+         writeSolutionText(fid, contents.instanceName, contents.seed, r.cost, r.dist, r.tard, r.tmax, r.routes);
+         if (!fid) {
+            cout << "Error writing solution file '" << output << "'.\n";
+            return EXIT_FAILURE;
+         }
+      } else {
+         writeSolutionText(cout, contents.instanceName, contents.seed, r.cost, r.dist, r.tard, r.tmax, r.routes);
+      }
+   } catch (const exception &e) {
+      cout << "Error: " << e.what() << endl;
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
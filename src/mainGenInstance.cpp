@@ -0,0 +1,305 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021
+ * Alberto Francisco Kummer Neto (afkneto@inf.ufrgs.br),
+ * Luciana Salete Buriol (buriol@inf.ufrgs.br),
+ * Olinto César Bassi de Araújo (olinto@ctism.ufsm.br) and
+ * Mauricio G.C. Resende (resendem@amazon.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "Instance.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/// Parameters of the synthetic instances.
+struct GenParams {
+   int patients;
+   int vehicles;
+   int skills;
+   double doubleFrac;   // Fraction of patients requiring double services...
+   double simFrac;      // ... and the fraction of those which are simultaneous.
+   double tightness;    // Within [0, 1]; 1 gives the narrowest time windows.
+   double horizon;      // Length of the planning horizon, in minutes.
+   double area;         // Side of the square region where nodes are placed.
+   unsigned seed;
+};
+
+/// Synthetic instance data, indexed as in the file format. Node 0 and n-1
+/// are the depot.
+struct GenInstance {
+   int n;
+   vector<vector<int>> req;     // [node][skill]
+   vector<vector<int>> qualif;  // [vehicle][skill]
+   vector<int> doubleSvc;       // 1-based identifiers, as in the file format
+   vector<double> x, y, e, l, mind, maxd;
+   vector<vector<double>> proc; // [node][skill]
+};
+
+/// Draws a random instance following the structure of the instances of
+/// Mankowska et al. (2014), scaled to arbitrary numbers of patients.
+GenInstance generate(const GenParams &par);
+
+/// Writes the instance in the text format read by `Instance`.
+void writeText(const GenInstance &gi, const GenParams &par, const string &fname);
+
+int main(int argc, char* argv[]) {
+   namespace po = boost::program_options;
+   po::options_description desc("Accepted command options are");
+   desc.add_options()
+      ("help,h", "shows this text")
+      ("output,o", po::value<string>(), "path to the text instance file to be written")
+      ("binary,b", po::value<string>(), "also writes the instance in the binary cache format to this path")
+      ("seed,s", po::value<int>()->default_value(1), "seed for the PRNG")
+      ("patients,n", po::value<int>()->default_value(1000), "number of patients")
+      ("vehicles,v", po::value<int>()->default_value(100), "number of caregivers")
+      ("skills", po::value<int>()->default_value(6), "number of service types")
+      ("double", po::value<double>()->default_value(0.3), "fraction of patients requiring double services")
+      ("sim", po::value<double>()->default_value(0.5), "fraction of double services that are simultaneous; "
+       "the remaining ones have precedence constraints")
+      ("tightness", po::value<double>()->default_value(0.8), "tightness of time windows within [0, 1]; "
+       "windows span (1 - tightness) of the horizon, and at least 30 minutes")
+      ("horizon", po::value<double>()->default_value(600.0), "length of the planning horizon, in minutes")
+      ("area", po::value<double>()->default_value(100.0), "side of the square region where nodes are placed")
+   ;
+
+   po::variables_map args;
+   po::store(po::parse_command_line(argc, argv, desc), args);
+   po::notify(args);
+
+   if (args.count("help") || !args.count("output")) {
+      cout << desc << "\n";
+      return EXIT_FAILURE;
+   }
+
+   GenParams par;
+   par.patients = args["patients"].as<int>();
+   par.vehicles = args["vehicles"].as<int>();
+   par.skills = args["skills"].as<int>();
+   par.doubleFrac = args["double"].as<double>();
+   par.simFrac = args["sim"].as<double>();
+   par.tightness = args["tightness"].as<double>();
+   par.horizon = args["horizon"].as<double>();
+   par.area = args["area"].as<double>();
+   par.seed = args["seed"].as<int>();
+
+   if (par.patients < 1 || par.vehicles < 2 || par.skills < 2 || par.skills > Instance::MAX_SKILLS ||
+         par.doubleFrac < 0.0 || par.doubleFrac > 1.0 || par.simFrac < 0.0 || par.simFrac > 1.0 ||
+         par.tightness < 0.0 || par.tightness > 1.0 || par.horizon <= 0.0 || par.area <= 0.0) {
+      cout << "Invalid instance parameters. Instances require at least one patient, two caregivers, "
+         "and from 2 to " << Instance::MAX_SKILLS << " service types. Fractions must be within [0, 1].\n";
+      return EXIT_FAILURE;
+   }
+
+   try {
+      const string output = args["output"].as<string>();
+      cout << "Generating instance with " << par.patients << " patients and " <<
+         par.vehicles << " caregivers...\n";
+      auto gi = generate(par);
+      writeText(gi, par, output);
+      cout << "Instance written to '" << output << "'.\n";
+
+      if (args.count("binary")) {
+         const string binary = args["binary"].as<string>();
+         Instance inst(output.c_str(), Instance::DIST_DENSE);
+         inst.writeBinary(binary.c_str());
+         cout << "Binary instance written to '" << binary << "'.\n";
+      }
+   } catch (const exception &e) {
+      cout << "Error: " << e.what() << endl;
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
+
+GenInstance generate(const GenParams &par) {
+   mt19937 rng(par.seed);
+   auto unif = [&] (double a, double b) {
+      return uniform_real_distribution<double>(a, b)(rng);
+   };
+   auto randInt = [&] (int a, int b) {
+      return uniform_int_distribution<int>(a, b)(rng);
+   };
+
+   GenInstance gi;
+   gi.n = par.patients + 2;
+   const int n = gi.n;
+
+   gi.req.assign(n, vector<int>(par.skills, 0));
+   gi.qualif.assign(par.vehicles, vector<int>(par.skills, 0));
+   gi.proc.assign(n, vector<double>(par.skills, 0.0));
+   gi.x.assign(n, par.area/2);
+   gi.y.assign(n, par.area/2);
+   gi.e.assign(n, 0.0);
+   gi.l.assign(n, par.horizon);
+   gi.mind.assign(n, 0.0);
+   gi.maxd.assign(n, 0.0);
+
+   // Caregivers are qualified to a random subset of the service types,
+   // and each service type is provided by at least two caregivers.
+   for (int v = 0; v < par.vehicles; ++v) {
+      const int cnt = randInt(1, max(1, par.skills/2));
+      vector<int> perm(par.skills);
+      iota(perm.begin(), perm.end(), 0);
+      shuffle(perm.begin(), perm.end(), rng);
+      for (int k = 0; k < cnt; ++k)
+         gi.qualif[v][perm[k]] = 1;
+   }
+   for (int s = 0; s < par.skills; ++s) {
+      int supply = 0;
+      for (int v = 0; v < par.vehicles; ++v)
+         supply += gi.qualif[v][s];
+      while (supply < 2) {
+         int v = randInt(0, par.vehicles-1);
+         if (!gi.qualif[v][s]) {
+            gi.qualif[v][s] = 1;
+            ++supply;
+         }
+      }
+   }
+
+   // Double services are assigned to a random subset of the patients, and
+   // the first `numSim` of them have simultaneous attendance.
+   vector<int> patients(par.patients);
+   iota(patients.begin(), patients.end(), 1);
+   shuffle(patients.begin(), patients.end(), rng);
+   const int numDouble = lround(par.doubleFrac * par.patients);
+   const int numSim = lround(par.simFrac * numDouble);
+
+   const double width = max(30.0, (1.0 - par.tightness) * par.horizon);
+   for (int k = 0; k < par.patients; ++k) {
+      const int i = patients[k];
+      gi.x[i] = round(unif(0.0, par.area));
+      gi.y[i] = round(unif(0.0, par.area));
+
+      const double start = round(unif(0.0, max(0.0, par.horizon - width)));
+      gi.e[i] = start;
+      gi.l[i] = start + round(width);
+
+      const int s0 = randInt(0, par.skills-1);
+      gi.req[i][s0] = 1;
+      gi.proc[i][s0] = randInt(10, 50);
+
+      if (k < numDouble) {
+         int s1 = randInt(0, par.skills-2);
+         if (s1 >= s0)
+            ++s1;
+         gi.req[i][s1] = 1;
+         gi.proc[i][s1] = randInt(10, 50);
+         gi.doubleSvc.push_back(i+1);
+
+         if (k >= numSim) {
+            gi.mind[i] = randInt(10, 40);
+            gi.maxd[i] = gi.mind[i] + randInt(10, 40);
+         }
+      }
+   }
+   sort(gi.doubleSvc.begin(), gi.doubleSvc.end());
+
+   return gi;
+}
+
+void writeText(const GenInstance &gi, const GenParams &par, const string &fname) {
+   FILE *fid = fopen(fname.c_str(), "w");
+   if (!fid)
+      throw runtime_error(fname + ": could not be created");
+
+   // Values are formatted through std::to_chars, as the distance matrix
+   // alone has tens of millions of values for the largest instances.
+   char buf[64];
+   auto put = [&] (double value, char sep, int precision = -1) {
+      auto res = precision >= 0 ?
+         to_chars(buf, buf + sizeof(buf) - 1, value, chars_format::fixed, precision) :
+         to_chars(buf, buf + sizeof(buf) - 1, value);
+      *res.ptr++ = sep;
+      fwrite(buf, 1, res.ptr - buf, fid);
+   };
+   auto putRow = [&] (const vector<double> &row, int precision = -1) {
+      for (size_t k = 0; k < row.size(); ++k)
+         put(row[k], k + 1 < row.size() ? ' ' : '\n', precision);
+   };
+   auto putIntRow = [&] (const vector<int> &row) {
+      putRow(vector<double>(row.begin(), row.end()));
+   };
+
+   const int n = gi.n;
+   fprintf(fid, "nbNodes\n%d\nnbVehi\n%d\nnbServi\n%d\n", n, par.vehicles, par.skills);
+
+   fprintf(fid, "r\n");
+   for (int i = 0; i < n; ++i)
+      putIntRow(gi.req[i]);
+
+   fprintf(fid, "DS\n");
+   putIntRow(gi.doubleSvc);
+   if (gi.doubleSvc.empty())
+      fprintf(fid, "\n");
+
+   fprintf(fid, "a\n");
+   for (const auto &row: gi.qualif)
+      putIntRow(row);
+
+   fprintf(fid, "x\n");
+   putRow(gi.x);
+   fprintf(fid, "y\n");
+   putRow(gi.y);
+
+   fprintf(fid, "d\n");
+   vector<double> row(n);
+   for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j)
+         row[j] = hypot(gi.x[i] - gi.x[j], gi.y[i] - gi.y[j]);
+      putRow(row, 4);
+   }
+
+   // The format repeats the processing times for every vehicle.
+   fprintf(fid, "p\n");
+   for (int i = 0; i < n; ++i)
+      for (int v = 0; v < par.vehicles; ++v)
+         putRow(gi.proc[i]);
+
+   fprintf(fid, "mind\n");
+   putRow(gi.mind);
+   fprintf(fid, "maxd\n");
+   putRow(gi.maxd);
+   fprintf(fid, "e\n");
+   putRow(gi.e);
+   fprintf(fid, "l\n");
+   putRow(gi.l);
+
+   if (ferror(fid) || fclose(fid) != 0)
+      throw runtime_error(fname + ": error writing the instance");
+}